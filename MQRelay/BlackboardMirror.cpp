@@ -0,0 +1,211 @@
+#include "BlackboardMirror.h"
+#include "RelayBatch.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using StreamFields = std::vector<std::pair<std::string, std::string>>;
+using StreamRecord = std::pair<std::string, std::optional<StreamFields>>;
+
+//How long a read of the stream waits for a record before checking for new keys and shutdown
+constexpr std::chrono::milliseconds FollowTimeout(100);
+
+sw::redis::ConnectionOptions MirrorOptions(const std::string& connectionString)
+{
+	sw::redis::ConnectionOptions options(connectionString);
+	//Has to outlast the blocking read, it only fires when redis stops answering
+	options.socket_timeout = std::chrono::seconds(1);
+	return options;
+}
+
+long long Now()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+}
+
+BlackboardMirror::BlackboardMirror(const std::string& connectionString)
+	: _redis(MirrorOptions(connectionString)), _thread(&BlackboardMirror::Run, this)
+{
+}
+
+BlackboardMirror::~BlackboardMirror()
+{
+	_running = false;
+	_thread.join();
+}
+
+void BlackboardMirror::SetKeys(const MirrorKeys& keys)
+{
+	std::lock_guard lock(_keysMutex);
+	_keys = keys;
+	_keysChanged = true;
+}
+
+bool BlackboardMirror::GetBlackboard(std::string_view field, char* buffer, size_t size) const
+{
+	std::shared_lock lock(_hashesMutex);
+	return Find(_blackboard, field, buffer, size);
+}
+
+bool BlackboardMirror::GetCharacter(std::string_view name, std::string_view field, char* buffer, size_t size) const
+{
+	std::shared_lock lock(_hashesMutex);
+	const sw::redis::StringView key = KeyBuffer(_characterPrefix, name);
+	return Find(std::string_view(key.data(), key.size()), field, buffer, size);
+}
+
+bool BlackboardMirror::Find(std::string_view key, std::string_view field, char* buffer, size_t size) const
+{
+	const auto hash = _hashes.find(key);
+	if (hash == _hashes.end())
+	{
+		return false;
+	}
+	const auto value = hash->second.find(field);
+	if (value == hash->second.end() || size == 0)
+	{
+		return false;
+	}
+	const size_t length = std::min(value->second.size(), size - 1);
+	memcpy(buffer, value->second.data(), length);
+	buffer[length] = '\0';
+	return true;
+}
+
+std::string BlackboardMirror::LastError() const
+{
+	std::lock_guard lock(_errorMutex);
+	return _lastError;
+}
+
+void BlackboardMirror::SetError(const char* error)
+{
+	std::lock_guard lock(_errorMutex);
+	_lastError = error;
+}
+
+void BlackboardMirror::Run()
+{
+	while (_running.load(std::memory_order_relaxed))
+	{
+		try
+		{
+			//Anything we missed while redis was away is only in the hashes now, so that reloads too
+			if (_keysChanged.exchange(false) || !_live)
+			{
+				_live = false;
+				{
+					std::lock_guard lock(_keysMutex);
+					_following = _keys;
+				}
+				if (_following.Stream.empty())
+				{
+					std::this_thread::sleep_for(FollowTimeout);
+					continue;
+				}
+				Load();
+				_live = true;
+			}
+			Follow();
+		}
+		catch (const sw::redis::Error& e)
+		{
+			_live = false;
+			SetError(e.what());
+			//Don't spin on a server that isn't there
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+	}
+}
+
+bool BlackboardMirror::Mirrored(std::string_view key) const
+{
+	if (key == _following.Blackboard)
+	{
+		return true;
+	}
+	//<prefix><name> is a character, <prefix><name>:buffs:1 and the like belong to one
+	const std::string_view prefix = _following.CharacterPrefix;
+	return key.size() > prefix.size() && key.substr(0, prefix.size()) == prefix && key.find(':', prefix.size()) == std::string_view::npos;
+}
+
+void BlackboardMirror::Load()
+{
+	//Where the stream is up to before reading the hashes, so nothing written while we read them is missed.
+	//Records from in between are applied on top, which only writes the same values again
+	std::vector<StreamRecord> last;
+	_redis.xrevrange(_following.Stream, "+", "-", 1, std::back_inserter(last));
+	_lastId = last.empty() ? "0-0" : last.front().first;
+
+	std::vector<std::string> keys;
+	long long cursor = 0;
+	do
+	{
+		cursor = _redis.scan(cursor, _following.CharacterPrefix + "*", 100, std::back_inserter(keys));
+	} while (cursor != 0);
+	keys.push_back(_following.Blackboard);
+
+	Hashes hashes;
+	for (const auto& key : keys)
+	{
+		if (!Mirrored(key))
+		{
+			continue;
+		}
+		Hash hash;
+		_redis.hgetall(key, std::inserter(hash, hash.end()));
+		if (!hash.empty())
+		{
+			hashes.emplace(key, std::move(hash));
+		}
+	}
+	std::unique_lock lock(_hashesMutex);
+	_hashes.swap(hashes);
+	_characterPrefix = _following.CharacterPrefix;
+	_blackboard = _following.Blackboard;
+	_lastChange = Now();
+}
+
+void BlackboardMirror::Follow()
+{
+	std::unordered_map<std::string, std::vector<StreamRecord>> streams;
+	_redis.xread(_following.Stream, _lastId, FollowTimeout, 256, std::inserter(streams, streams.end()));
+	for (auto& [stream, records] : streams)
+	{
+		for (auto& [id, fields] : records)
+		{
+			_lastId = id;
+			if (!fields)
+			{
+				continue;
+			}
+			const auto key = std::find_if(fields->begin(), fields->end(), [](const auto& field) { return field.first == "Key"; });
+			if (key == fields->end() || !Mirrored(key->second))
+			{
+				continue;
+			}
+			const bool removed = std::any_of(fields->begin(), fields->end(), [](const auto& field) { return field.first == "Removed"; });
+			std::unique_lock lock(_hashesMutex);
+			if (removed)
+			{
+				_hashes.erase(key->second);
+				continue;
+			}
+			auto& hash = _hashes[key->second];
+			for (auto& [name, value] : *fields)
+			{
+				if (name != "Key" && name != "Time")
+				{
+					hash[name] = std::move(value);
+				}
+			}
+		}
+		_lastChange = Now();
+	}
+}
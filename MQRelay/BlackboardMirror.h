@@ -0,0 +1,84 @@
+#pragma once
+#include <sw/redis++/redis.h>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+//What the mirror follows, empty keys mirror nothing
+struct MirrorKeys
+{
+	//<server>:<leader>:changes, see RelayOptions::ChangeStreams
+	std::string Stream;
+	//<server>:<leader>:characters:, a character's name is appended for its hash
+	std::string CharacterPrefix;
+	//<server>:<leader>:blackboard, written by the coordinator
+	std::string Blackboard;
+};
+
+//A local copy of the group's character hashes and the coordinator's blackboard, so Lua can read them every
+//frame without going to redis. It's loaded in full when it starts, whenever the keys change and after redis comes
+//back, and in between it follows the group's change stream on its own connection and thread.
+//The character hashes only change in the mirror when their relays have ChangeStreams set. The coordinator writes
+//the blackboard hash and adds a record to the stream the same way, Key and Time then the fields it set
+class BlackboardMirror
+{
+public:
+	explicit BlackboardMirror(const std::string& connectionString);
+	~BlackboardMirror();
+	BlackboardMirror(const BlackboardMirror&) = delete;
+	BlackboardMirror& operator=(const BlackboardMirror&) = delete;
+
+	//Game thread only. The mirror reloads from these keys the next time it wakes up
+	void SetKeys(const MirrorKeys& keys);
+	//Any thread. Copies the value into buffer, truncating it to fit, and returns false if the field isn't mirrored
+	bool GetBlackboard(std::string_view field, char* buffer, size_t size) const;
+	bool GetCharacter(std::string_view name, std::string_view field, char* buffer, size_t size) const;
+	//Whether the mirror is loaded and following the stream
+	[[nodiscard]] bool Live() const { return _live.load(std::memory_order_relaxed); }
+	//Milliseconds since the epoch when the mirror last changed, 0 if it hasn't
+	[[nodiscard]] long long LastChange() const { return _lastChange.load(std::memory_order_relaxed); }
+	[[nodiscard]] std::string LastError() const;
+
+private:
+	//Lets the maps be searched with a string_view without building a string
+	struct NameHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+	};
+	using Hash = std::unordered_map<std::string, std::string, NameHash, std::equal_to<>>;
+	using Hashes = std::unordered_map<std::string, Hash, NameHash, std::equal_to<>>;
+
+	void Run();
+	void Load();
+	void Follow();
+	//Whether a key is one the mirror keeps, the character hashes under CharacterPrefix and the blackboard
+	[[nodiscard]] bool Mirrored(std::string_view key) const;
+	//Callers hold _hashesMutex
+	bool Find(std::string_view key, std::string_view field, char* buffer, size_t size) const;
+	void SetError(const char* error);
+	sw::redis::Redis _redis;
+	mutable std::shared_mutex _hashesMutex;
+	Hashes _hashes;
+	std::mutex _keysMutex;
+	MirrorKeys _keys;
+	//The mirror thread's copy, only touched by it
+	MirrorKeys _following;
+	//The last stream record applied
+	std::string _lastId;
+	//Read from any thread, only written by the mirror thread while it holds _hashesMutex
+	std::string _characterPrefix;
+	std::string _blackboard;
+	std::atomic<bool> _keysChanged = true;
+	std::atomic<bool> _live = false;
+	std::atomic<long long> _lastChange = 0;
+	std::atomic<bool> _running = true;
+	mutable std::mutex _errorMutex;
+	std::string _lastError;
+	//Declared last so everything above exists before the thread starts
+	std::thread _thread;
+};
@@ -0,0 +1,44 @@
+#include "ChangeRecord.h"
+
+void ChangeRecord::Begin()
+{
+	_next = 0;
+	_changes.Clear();
+}
+
+void ChangeRecord::Field(std::string_view name, const sw::redis::StringView& value)
+{
+	if (_next == _fields.size())
+	{
+		_fields.emplace_back();
+	}
+	auto& field = _fields[_next++];
+	if (field.Name == name && field.Value == std::string_view(value.data(), value.size()))
+	{
+		return;
+	}
+	//assign reuses the entry's storage, it only allocates when a value outgrows it
+	field.Name.assign(name.data(), name.size());
+	field.Value.assign(value.data(), value.size());
+	_changes.Add(name);
+	_changes.Add(value);
+}
+
+void ChangeRecord::Flush(RelayBatch& batch, const sw::redis::StringView& stream, const sw::redis::StringView& key, long long time, unsigned maxLength)
+{
+	if (_changes.Empty())
+	{
+		return;
+	}
+	//~ lets redis trim whole nodes at a time, the stream ends up a little over maxLength instead of exactly at it
+	batch.Command("XADD", stream, "MAXLEN", "~", maxLength, "*", "Key", key, "Time", time);
+	batch.Args(_changes);
+	_changes.Clear();
+}
+
+void ChangeRecord::Reset()
+{
+	_fields.clear();
+	_next = 0;
+	_changes.Clear();
+}
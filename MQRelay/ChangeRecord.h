@@ -0,0 +1,28 @@
+#pragma once
+#include "RelayBatch.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Remembers what was last written to one hash so a change stream record only carries the fields that changed.
+//Fields have to be given in the same order every time, which is how the Update functions already write them
+class ChangeRecord
+{
+public:
+	void Begin();
+	void Field(std::string_view name, const sw::redis::StringView& value);
+	//Adds an XADD of Key, Time and the changed fields to the batch, nothing when no field changed
+	void Flush(RelayBatch& batch, const sw::redis::StringView& stream, const sw::redis::StringView& key, long long time, unsigned maxLength);
+	//The next record carries every field, for when the hash it describes has moved to another key
+	void Reset();
+
+private:
+	struct Entry
+	{
+		std::string Name;
+		std::string Value;
+	};
+	std::vector<Entry> _fields;
+	size_t _next = 0;
+	ArgBuffer _changes;
+};
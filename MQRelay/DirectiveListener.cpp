@@ -0,0 +1,178 @@
+#include "DirectiveListener.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+sw::redis::ConnectionOptions ListenerOptions(const std::string& connectionString)
+{
+	sw::redis::ConnectionOptions options(connectionString);
+	//consume() gives up after this long without a message, which is how often the thread checks for
+	//new channels and shutdown. Directives themselves are delivered the moment they're published
+	options.socket_timeout = std::chrono::milliseconds(100);
+	return options;
+}
+}
+
+DirectiveListener::DirectiveListener(const std::string& connectionString, RelayMetrics& metrics, const std::atomic<long long>& publishedVersion)
+	: _redis(ListenerOptions(connectionString)), _metrics(metrics), _publishedVersion(publishedVersion), _thread(&DirectiveListener::Run, this)
+{
+}
+
+DirectiveListener::~DirectiveListener()
+{
+	_running = false;
+	_thread.join();
+}
+
+void DirectiveListener::SetChannels(const CoordinatorChannels& channels)
+{
+	std::lock_guard lock(_channelMutex);
+	_channels = channels;
+	_channelsChanged = true;
+}
+
+bool DirectiveListener::TryPop(Directive& directive)
+{
+	return _directives.TryPop(directive);
+}
+
+std::string DirectiveListener::LastError() const
+{
+	std::lock_guard lock(_errorMutex);
+	return _lastError;
+}
+
+void DirectiveListener::SetError(const char* error)
+{
+	std::lock_guard lock(_errorMutex);
+	_lastError = error;
+}
+
+void DirectiveListener::Run()
+{
+	while (_running.load(std::memory_order_relaxed))
+	{
+		try
+		{
+			auto subscriber = _redis.subscriber();
+			subscriber.on_message([this](const std::string& channel, const std::string& message) {
+				if (channel == _subscribed.Heartbeat)
+				{
+					Heartbeat(message);
+				}
+				else
+				{
+					Receive(message);
+				}
+			});
+			//A new connection has nothing subscribed, so it always starts with the current channels
+			_channelsChanged = true;
+			while (_running.load(std::memory_order_relaxed))
+			{
+				if (_channelsChanged.exchange(false))
+				{
+					{
+						std::lock_guard lock(_channelMutex);
+						_subscribed = _channels;
+					}
+					subscriber.unsubscribe();
+					for (const auto* channel : { &_subscribed.Directives, &_subscribed.GroupDirectives, &_subscribed.Heartbeat })
+					{
+						if (!channel->empty())
+						{
+							subscriber.subscribe(*channel);
+						}
+					}
+				}
+				try
+				{
+					subscriber.consume();
+				}
+				catch (const sw::redis::TimeoutError&)
+				{
+					//Nothing was published, go round and check for new channels
+				}
+			}
+		}
+		catch (const sw::redis::Error& e)
+		{
+			SetError(e.what());
+			//Don't spin on a server that isn't there
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+	}
+}
+
+void DirectiveListener::Receive(std::string_view message)
+{
+	//Whitespace around the command is the publisher's formatting, not part of it
+	const auto first = message.find_first_not_of(" \t\r\n");
+	const auto last = message.find_last_not_of(" \t\r\n");
+	if (first == std::string_view::npos)
+	{
+		_metrics.DroppedDirectives.Add();
+		return;
+	}
+	message = message.substr(first, last - first + 1);
+	//One command per directive, anything that isn't a single slash command is refused rather than guessed at
+	if (message.front() != '/' || message.size() >= _received.Command.size() ||
+		std::any_of(message.begin(), message.end(), [](char c) { return c == '\r' || c == '\n' || c == '\0'; }))
+	{
+		_metrics.DroppedDirectives.Add();
+		return;
+	}
+	_received.Received = std::chrono::steady_clock::now();
+	memcpy(_received.Command.data(), message.data(), message.size());
+	_received.Command[message.size()] = '\0';
+	if (!_directives.TryPush(_received))
+	{
+		_metrics.DroppedDirectives.Add();
+	}
+}
+
+void DirectiveListener::Heartbeat(std::string_view message)
+{
+	const auto received = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	long long tick = 0;
+	long long sent = 0;
+	const char* end = message.data() + message.size();
+	auto [next, error] = std::from_chars(message.data(), end, tick);
+	if (error != std::errc() || _subscribed.Pong.empty())
+	{
+		return;
+	}
+	while (next != end && *next == ' ')
+	{
+		++next;
+	}
+	//Without the coordinator's time we can still answer, there's just nothing to measure
+	const bool timed = std::from_chars(next, end, sent).ec == std::errc() && sent <= received;
+	if (_lastTick && tick > _lastTick + 1)
+	{
+		_metrics.MissedHeartbeats.Add(static_cast<uint64_t>(tick - _lastTick - 1));
+	}
+	_lastTick = tick;
+
+	char buffer[32];
+	_pong.clear();
+	_pong.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), tick).ptr);
+	_pong += ' ';
+	_pong.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), sent).ptr);
+	_pong += ' ';
+	_pong += _subscribed.Agent;
+	_pong += ' ';
+	_pong.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), _publishedVersion.load(std::memory_order_relaxed)).ptr);
+	//Our own connection, the subscriber's can't publish while it's subscribed
+	_redis.publish(_subscribed.Pong, _pong);
+	_metrics.Heartbeats.Add();
+	if (timed)
+	{
+		//Both need the coordinator's clock to agree with ours, which it does when they share a machine.
+		//Lag is the coordinator to us, Reply adds redis taking the pong
+		const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		_metrics.HeartbeatLag.Record(static_cast<uint64_t>(received - sent) * 1000);
+		_metrics.HeartbeatReply.Record(static_cast<uint64_t>(now - sent) * 1000);
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "RelayMetrics.h"
+#include "SpscQueue.h"
+#include <sw/redis++/redis.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+//A command from the coordinator for this character to run
+struct Directive
+{
+	//When the listener received it, for timing how long it waited for the game thread
+	std::chrono::steady_clock::time_point Received;
+	//Null terminated, always starts with a /
+	std::array<char, 2048> Command{};
+};
+
+//What the listener subscribes to, an empty channel is one it doesn't listen on
+struct CoordinatorChannels
+{
+	//<character>:directives and <server>:<leader>:directives
+	std::string Directives;
+	std::string GroupDirectives;
+	//<server>:heartbeat, answered on <server>:pong as Agent
+	std::string Heartbeat;
+	std::string Pong;
+	std::string Agent;
+};
+
+//Listens to the coordinator on its own connection and thread.
+//Directives are published to <character>:directives for one character or <server>:<leader>:directives
+//for the whole group, the message is the command to run. Nothing here touches the game, the plugin
+//drains the queue every pulse and runs what it finds.
+//Heartbeats are "<tick> <coordinator time in ms>" and are answered from this thread with
+//"<tick> <coordinator time> <agent> <published state version>", so a busy frame never delays a pong
+class DirectiveListener
+{
+public:
+	//publishedVersion is the last state version the RelayWorker got into redis
+	DirectiveListener(const std::string& connectionString, RelayMetrics& metrics, const std::atomic<long long>& publishedVersion);
+	~DirectiveListener();
+	DirectiveListener(const DirectiveListener&) = delete;
+	DirectiveListener& operator=(const DirectiveListener&) = delete;
+
+	//Game thread only. The listener moves over to these channels the next time it wakes up
+	void SetChannels(const CoordinatorChannels& channels);
+	//Game thread only. Returns false once there's nothing left to run
+	bool TryPop(Directive& directive);
+
+	[[nodiscard]] std::string LastError() const;
+
+private:
+	void Run();
+	void Receive(std::string_view message);
+	void Heartbeat(std::string_view message);
+	void SetError(const char* error);
+	sw::redis::Redis _redis;
+	//The listener records DroppedDirectives and the heartbeat metrics, nothing else
+	RelayMetrics& _metrics;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	const std::atomic<long long>& _publishedVersion;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	SpscQueue<Directive, 64> _directives;
+	//Filled in on the listener thread and moved into the queue, kept so receiving doesn't touch the stack much
+	Directive _received;
+	std::mutex _channelMutex;
+	CoordinatorChannels _channels;
+	//The listener thread's copy, only touched by it
+	CoordinatorChannels _subscribed;
+	long long _lastTick = 0;
+	std::string _pong;
+	std::atomic<bool> _channelsChanged = false;
+	std::atomic<bool> _running = true;
+	mutable std::mutex _errorMutex;
+	std::string _lastError;
+	//Declared last so everything above exists before the thread starts
+	std::thread _thread;
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+//Everything Relay publishes is read through a GameStateProvider, so Relay itself never touches MQ.
+//MQGameState reads the live client, the benchmarks use a synthetic provider.
+//
+//Views handed out by a provider stay valid until the next call that reads the same kind of thing,
+//spawn names until the spawn is removed
+
+//Identifies a spawn to the provider that handed it out, 0 is no spawn
+using SpawnHandle = uintptr_t;
+
+struct CharacterStats
+{
+	unsigned SpawnId = 0;
+	int64_t MaxHP = 0;
+	int MaxMana = 0;
+	int MaxEndurance = 0;
+	int Level = 0;
+	float PctExp = 0;
+	float PctAAExp = 0;
+	int Class = 0;
+};
+
+struct CharacterState
+{
+	int64_t CurrentHP = 0;
+	int CurrentMana = 0;
+	int CurrentEndurance = 0;
+	std::string_view CombatState;
+	int CastingSpellId = 0;
+	unsigned CastingTargetId = 0;
+	int CastingETA = 0;
+	bool AutoAttacking = false;
+	bool AutoFiring = false;
+	//Degrees
+	float Heading = 0;
+	unsigned TargetId = 0;
+	int PctAggro = 0;
+	float X = 0;
+	float Y = 0;
+	float Z = 0;
+	//These describe the target and are only read when there is one
+	unsigned TargetOfTarget = 0;
+	unsigned SecondaryAggroId = 0;
+	int SecondaryAggroPct = 0;
+};
+
+enum class BuffKind : uint8_t
+{
+	Buff,
+	Song
+};
+
+//One of our own buff slots, SpellId is 0 when the slot is empty and nothing else is filled in
+struct BuffState
+{
+	int SpellId = 0;
+	int Duration = 0;
+	int CorruptionCounters = 0;
+	int CurseCounters = 0;
+	int DiseaseCounters = 0;
+	int PoisonCounters = 0;
+	int HitCount = 0;
+};
+
+//The cheap part of a buff slot, enough to tell whether the rest needs reading again
+struct BuffSignature
+{
+	int SpellId = 0;
+	//Changes whenever anything but the remaining duration does, counters and hit count included
+	uint64_t Fingerprint = 0;
+	//Remaining duration in whatever unit the provider likes, it only goes up when the buff is refreshed
+	int64_t Remaining = 0;
+};
+
+struct XTargetState
+{
+	unsigned SpawnId = 0;
+	int AggroPct = 0;
+	std::string_view Role;
+	bool LineOfSight = false;
+	int64_t PctHP = 0;
+};
+
+struct GroupRoles
+{
+	unsigned Puller = 0;
+	unsigned Assist = 0;
+	unsigned Tank = 0;
+	unsigned Looter = 0;
+	unsigned Marker = 0;
+};
+
+struct SpawnState
+{
+	unsigned SpawnId = 0;
+	unsigned MasterId = 0;
+	//Filled in by SpawnTable from OwnerName
+	unsigned OwnerId = 0;
+	unsigned PetId = 0;
+	int Class = 0;
+	int Type = 0;
+	int Mark = 0;
+	int Level = 0;
+	std::string_view Name;
+	//The name of the spawn that owns a mercenary, empty for anything else
+	std::string_view OwnerName;
+	float X = 0;
+	float Y = 0;
+	float Z = 0;
+	//Degrees
+	float Heading = 0;
+	//Squared distance from the controlled player, it's only ever compared. Filled in by SpawnTable
+	float Distance = 0;
+	float Speed = 0;
+	//Filled in by SpawnTable
+	float MaxRange = 0;
+	float MaxRangeTo = 0;
+	bool Stunned = false;
+	bool Targetable = false;
+};
+
+//Where a spawn is, read for every spawn each update so it's only what the distances need
+struct SpawnPosition
+{
+	float X = 0;
+	float Y = 0;
+	//An NPC that isn't anyone's pet, what the group proximity counts
+	bool Hostile = false;
+};
+
+struct GroupMemberPosition
+{
+	std::string_view Name;
+	float X = 0;
+	float Y = 0;
+};
+
+struct SpawnBuffState
+{
+	int Slot = 0;
+	int64_t Staleness = 0;
+	int SpellId = 0;
+	std::string_view Caster;
+	int64_t Duration = 0;
+};
+
+class GameStateProvider
+{
+public:
+	virtual ~GameStateProvider() = default;
+
+	//Names the keys are built from
+	virtual std::string_view ServerName() = 0;
+	virtual std::string_view ZoneName() = 0;
+	virtual std::string_view CharacterName() = 0;
+	//"Ungrouped" when we aren't in a group
+	virtual std::string_view GroupLeaderName() = 0;
+
+	virtual void ReadCharacterStats(CharacterStats& stats) = 0;
+	virtual void ReadCharacterState(CharacterState& state) = 0;
+	virtual size_t BuffSlotCount(BuffKind kind) = 0;
+	virtual void ReadBuffSignature(BuffKind kind, size_t slot, BuffSignature& signature) = 0;
+	virtual void ReadBuff(BuffKind kind, size_t slot, BuffState& buff) = 0;
+	virtual size_t XTargetSlotCount() = 0;
+	//False if the slot is empty
+	virtual bool ReadXTarget(size_t slot, XTargetState& xTarget) = 0;
+	//False unless we lead a group, only the leader publishes it
+	virtual bool ReadGroupRoles(GroupRoles& roles) = 0;
+
+	//Spawns are walked with FirstSpawn and NextSpawn, a handle is valid until that spawn is removed.
+	//NextSpawn still works on a spawn while Relay::OnRemoveSpawn is being told about it
+	virtual SpawnHandle FirstSpawn() = 0;
+	virtual SpawnHandle NextSpawn(SpawnHandle spawn) = 0;
+	//Everything but OwnerId, Distance, MaxRange and MaxRangeTo, read them through SpawnTable
+	virtual void ReadSpawn(SpawnHandle spawn, SpawnState& state) = 0;
+	//Parts of ReadSpawn for when the rest isn't needed: the spawn's SpawnState::SpawnId, its position for
+	//deciding whether the rest is worth reading, and its SpawnState::Name for finding it by name
+	virtual unsigned ReadSpawnId(SpawnHandle spawn) = 0;
+	virtual void ReadSpawnPosition(SpawnHandle spawn, SpawnPosition& position) = 0;
+	virtual std::string_view ReadSpawnName(SpawnHandle spawn) = 0;
+	//The spawn we control first, distances are measured from it, then the rest of the group in the zone.
+	//Returns how many were written, no more than count
+	virtual size_t ReadGroupPositions(GroupMemberPosition* members, size_t count) = 0;
+	//Changes whenever anything the melee ranges between the spawn and us are worked out from does
+	virtual uint64_t ReadMeleeRangeSignature(SpawnHandle spawn) = 0;
+	virtual void ReadMeleeRanges(SpawnHandle spawn, float& maxRange, float& maxRangeTo) = 0;
+	virtual size_t SpawnBuffCount(SpawnHandle spawn) = 0;
+	//False if nothing is cached for that buff
+	virtual bool ReadSpawnBuff(SpawnHandle spawn, size_t index, SpawnBuffState& buff) = 0;
+
+	//Something a person should see, in game this goes to chat
+	virtual void ReportError(const char* message) = 0;
+};
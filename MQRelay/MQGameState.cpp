@@ -0,0 +1,332 @@
+#include "MQGameState.h"
+
+std::string_view MQGameState::ServerName()
+{
+	return GetServerShortName();
+}
+
+std::string_view MQGameState::ZoneName()
+{
+	//pZoneInfo and pLocalPC are only missing outside the game, the names are empty until they're back
+	if (!pZoneInfo)
+	{
+		return {};
+	}
+	return pZoneInfo->ShortName;
+}
+
+std::string_view MQGameState::CharacterName()
+{
+	if (!pLocalPC)
+	{
+		return {};
+	}
+	strcpy_s(_characterName, MAX_STRING, pLocalPC->Name);
+	return CleanupName(_characterName, MAX_STRING, false, false);
+}
+
+std::string_view MQGameState::GroupLeaderName()
+{
+	if (pLocalPC && pLocalPC->Group)
+	{
+		//The leader has no spawn when they're in another zone, their name is on the group member either way
+		if (const CGroupMember* pLeader = pLocalPC->Group->GetGroupLeader())
+		{
+			strcpy_s(_leaderName, pLeader->Name.c_str());
+			return CleanupName(_leaderName, MAX_STRING, false, false);
+		}
+	}
+
+	return "Ungrouped";
+}
+
+void MQGameState::ReadCharacterStats(CharacterStats& stats)
+{
+	stats.SpawnId = pLocalPlayer->SpawnID;
+	stats.MaxHP = GetMaxHPS();
+	stats.MaxMana = GetMaxMana();
+	stats.MaxEndurance = GetMaxEndurance();
+	stats.Level = pLocalPlayer->Level;
+	stats.PctExp = static_cast<float>(pLocalPC->Exp) / EXP_TO_PCT_RATIO;
+	stats.PctAAExp = static_cast<float>(pLocalPC->AAExp) / EXP_TO_PCT_RATIO;
+	stats.Class = pLocalPlayer->GetClass();
+}
+
+void MQGameState::ReadCharacterState(CharacterState& state)
+{
+	state.CurrentHP = GetCurHPS();
+	state.CurrentMana = GetCurMana();
+	state.CurrentEndurance = GetCurEndurance();
+	state.CombatState = GetCombatState();
+	state.CastingSpellId = pLocalPlayer->CastingData.SpellID;
+	state.CastingTargetId = pLocalPlayer->CastingData.TargetID;
+	state.CastingETA = pLocalPlayer->CastingData.SpellETA;
+	state.AutoAttacking = pEverQuestInfo->bAutoAttack;
+	state.AutoFiring = pEverQuestInfo->bAutoRangeAttack != 0;
+	state.Heading = pLocalPlayer->Heading * 0.703125f;
+	state.TargetId = pTarget ? pTarget->SpawnID : 0;
+	state.PctAggro = pAggroInfo->aggroData[AD_Player].AggroPct;
+	state.X = pLocalPlayer->X;
+	state.Y = pLocalPlayer->Y;
+	state.Z = pLocalPlayer->Z;
+	state.TargetOfTarget = pLocalPlayer->TargetOfTarget;
+	state.SecondaryAggroId = pAggroInfo->AggroSecondaryID;
+	state.SecondaryAggroPct = pAggroInfo->aggroData[AD_Secondary].AggroPct;
+}
+
+size_t MQGameState::BuffSlotCount(BuffKind kind)
+{
+	return kind == BuffKind::Buff ? NUM_LONG_BUFFS : NUM_SHORT_BUFFS;
+}
+
+void MQGameState::ReadBuffSignature(BuffKind kind, size_t slot, BuffSignature& signature)
+{
+	const auto* characterInfo2 = GetPcProfile();
+	const auto& affect = kind == BuffKind::Buff ? characterInfo2->GetEffect(static_cast<int>(slot)) : characterInfo2->GetTempEffect(static_cast<int>(slot));
+	signature.SpellId = affect.SpellID;
+	//Ticks left, counting down on its own
+	signature.Remaining = affect.Duration;
+	//The counters GetSpellCounters reports live in the slot data, so hashing it is enough to notice a cure
+	uint64_t fingerprint = static_cast<uint32_t>(affect.HitCount);
+	for (const auto& data : affect.SlotData)
+	{
+		fingerprint = fingerprint * 31 + static_cast<uint32_t>(data.Slot);
+		fingerprint = fingerprint * 31 + static_cast<uint64_t>(data.Value);
+	}
+	signature.Fingerprint = fingerprint;
+}
+
+void MQGameState::ReadBuff(BuffKind kind, size_t slot, BuffState& buff)
+{
+	const auto* characterInfo2 = GetPcProfile();
+	const auto& affect = kind == BuffKind::Buff ? characterInfo2->GetEffect(static_cast<int>(slot)) : characterInfo2->GetTempEffect(static_cast<int>(slot));
+	buff = {};
+	buff.SpellId = affect.SpellID;
+	if (affect.SpellID > 0)
+	{
+		buff.Duration = GetSpellBuffTimer(affect.SpellID);
+		buff.CorruptionCounters = GetSpellCounters(SPA_CORRUPTION, affect);
+		buff.CurseCounters = GetSpellCounters(SPA_CURSE, affect);
+		buff.DiseaseCounters = GetSpellCounters(SPA_DISEASE, affect);
+		buff.PoisonCounters = GetSpellCounters(SPA_POISON, affect);
+		buff.HitCount = affect.HitCount;
+	}
+}
+
+size_t MQGameState::XTargetSlotCount()
+{
+	const auto xManager = GetCharInfo()->pXTargetMgr;
+	return xManager ? xManager->XTargetSlots.Count : 0;
+}
+
+bool MQGameState::ReadXTarget(size_t slot, XTargetState& xTarget)
+{
+	const auto xManager = GetCharInfo()->pXTargetMgr;
+	const auto [xTargetType, XTargetSlotStatus, spawnId, _] = xManager->XTargetSlots[static_cast<int>(slot)];
+	if (!xTargetType || !XTargetSlotStatus)
+	{
+		return false;
+	}
+	const auto spawn = GetSpawnByID(spawnId);
+	xTarget.SpawnId = spawnId;
+	xTarget.AggroPct = pAggroInfo->aggroData[AD_xTarget1 + slot].AggroPct;
+	xTarget.Role = xManager->ExtendedTargetRoleName(xTargetType);
+	xTarget.LineOfSight = spawn && pControlledPlayer->CanSee(*spawn);
+	xTarget.PctHP = spawn ? GetPctHP(spawn) : 0;
+	return true;
+}
+
+bool MQGameState::ReadGroupRoles(GroupRoles& roles)
+{
+	if (pLocalPC->Group == nullptr || !pLocalPC->Group->IsGroupLeader(pLocalPC->me))
+	{
+		return false;
+	}
+	const auto roleId = [](int role) -> unsigned {
+		const CGroupMember* member = pLocalPC->Group->GetGroupMemberByRole(role);
+		return member && member->pSpawn ? member->pSpawn->SpawnID : 0;
+	};
+	roles.Puller = roleId(GroupRolePuller);
+	roles.Assist = roleId(GroupRoleAssist);
+	roles.Tank = roleId(GroupRoleTank);
+	roles.Looter = roleId(GroupRoleMasterLooter);
+	roles.Marker = roleId(GroupRoleMarkNPC);
+	return true;
+}
+
+SpawnHandle MQGameState::FirstSpawn()
+{
+	return ToHandle(pSpawnManager->FirstSpawn);
+}
+
+SpawnHandle MQGameState::NextSpawn(SpawnHandle spawn)
+{
+	return ToHandle(ToSpawn(spawn)->GetNext());
+}
+
+void MQGameState::ReadSpawn(SpawnHandle handle, SpawnState& state)
+{
+	auto* spawn = ToSpawn(handle);
+	state.SpawnId = spawn->SpawnID;
+	state.MasterId = spawn->MasterID;
+	state.OwnerName = GetOwnerName(spawn);
+	state.PetId = spawn->PetID;
+	state.Class = spawn->GetClass();
+	state.Type = static_cast<int>(GetSpawnType(spawn));
+	state.Mark = static_cast<int>(GetNPCMarkNumber(spawn));
+	state.Level = spawn->Level;
+	state.Name = spawn->Name;
+	state.X = spawn->X;
+	state.Y = spawn->Y;
+	state.Z = spawn->Z;
+	state.Heading = spawn->Heading * 0.703125f;
+	state.Speed = FindSpeed(spawn);
+	state.Stunned = (spawn->PlayerState & 0x20) != 0;
+	state.Targetable = spawn->Targetable;
+}
+
+unsigned MQGameState::ReadSpawnId(SpawnHandle spawn)
+{
+	return ToSpawn(spawn)->SpawnID;
+}
+
+void MQGameState::ReadSpawnPosition(SpawnHandle handle, SpawnPosition& position)
+{
+	const auto* spawn = ToSpawn(handle);
+	position.X = spawn->X;
+	position.Y = spawn->Y;
+	position.Hostile = spawn->Type == SPAWN_NPC && spawn->MasterID == 0;
+}
+
+std::string_view MQGameState::ReadSpawnName(SpawnHandle spawn)
+{
+	return ToSpawn(spawn)->Name;
+}
+
+size_t MQGameState::ReadGroupPositions(GroupMemberPosition* members, size_t count)
+{
+	if (!pControlledPlayer || count == 0)
+	{
+		return 0;
+	}
+	//Measured from whatever we're controlling, but it's still us as far as the group is concerned
+	members[0] = { pLocalPlayer->Name, pControlledPlayer->X, pControlledPlayer->Y };
+	size_t written = 1;
+	if (pLocalPC->Group)
+	{
+		for (int i = 0; i < MAX_GROUP_SIZE && written < count; ++i)
+		{
+			const CGroupMember* member = pLocalPC->Group->GetGroupMember(i);
+			if (member && member->pSpawn && member->pSpawn != pLocalPlayer)
+			{
+				members[written++] = { member->pSpawn->Name, member->pSpawn->X, member->pSpawn->Y };
+			}
+		}
+	}
+	return written;
+}
+
+uint64_t MQGameState::ReadMeleeRangeSignature(SpawnHandle handle)
+{
+	//GetMeleeRange only looks at the radius and height of both spawns
+	const auto* spawn = ToSpawn(handle);
+	const auto bits = [](float value) {
+		uint32_t result = 0;
+		memcpy(&result, &value, sizeof(result));
+		return static_cast<uint64_t>(result);
+	};
+	uint64_t signature = reinterpret_cast<uintptr_t>(pControlledPlayer);
+	for (const auto* size : { spawn, static_cast<const PlayerClient*>(pControlledPlayer) })
+	{
+		signature = signature * 31 + bits(size->GetMeleeRangeVar1);
+		signature = signature * 31 + bits(size->MeleeRadius);
+		signature = signature * 31 + bits(size->AvatarHeight);
+	}
+	return signature;
+}
+
+void MQGameState::ReadMeleeRanges(SpawnHandle handle, float& maxRange, float& maxRangeTo)
+{
+	auto* spawn = ToSpawn(handle);
+	maxRange = GetMeleeRange(spawn, pControlledPlayer);
+	maxRangeTo = GetMeleeRange(pControlledPlayer, spawn);
+}
+
+size_t MQGameState::SpawnBuffCount(SpawnHandle spawn)
+{
+	const int count = GetCachedBuffCount(ToSpawn(spawn));
+	return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+bool MQGameState::ReadSpawnBuff(SpawnHandle handle, size_t index, SpawnBuffState& buff)
+{
+	auto* spawn = ToSpawn(handle);
+	const auto buffSlot = GetCachedBuffAt(spawn, static_cast<int>(index));
+	const auto cachedBuff = GetCachedBuffAtSlot(spawn, buffSlot);
+	if (!cachedBuff)
+	{
+		return false;
+	}
+	buff.Slot = buffSlot;
+	buff.Staleness = cachedBuff->Staleness();
+	buff.SpellId = cachedBuff->spellId;
+	buff.Caster = cachedBuff->casterName;
+	buff.Duration = cachedBuff->Duration();
+	return true;
+}
+
+void MQGameState::ReportError(const char* message)
+{
+	WriteChatColorf("MQRelay: %s", CONCOLOR_RED, message);
+}
+
+std::string_view MQGameState::GetCombatState()
+{
+	switch (pPlayerWnd->CombatState)
+	{
+	case eCombatState_Combat:
+		if (pPlayerWnd->GetChildItem("PW_CombatStateAnim"))
+		{
+			return "COMBAT";
+		}
+		return "NULL";
+
+	case eCombatState_Debuff:
+		return "DEBUFFED";
+
+	case eCombatState_Timer:
+		return "COOLDOWN";
+
+	case eCombatState_Standing:
+		return "ACTIVE";
+
+	case eCombatState_Regen:
+		return "RESTING";
+
+	default:
+		//Only ever read on the game thread before the next call
+		static char buffer[32] = { 0 };
+		sprintf_s(buffer, "UNKNOWN(%d)", pPlayerWnd->CombatState);// NOLINT(cert-err33-c)
+		return buffer;
+	}
+}
+
+int64_t MQGameState::GetPctHP(const PlayerClient* pSpawn)
+{
+	return pSpawn->HPMax == 0 ? 0 : pSpawn->HPCurrent * 100 / pSpawn->HPMax;
+}
+
+std::string_view MQGameState::GetOwnerName(const PlayerClient* spawn)
+{
+	//Mercenaries are named after their owner, "Soandso's Mercenary"
+	if (!spawn->Mercenary)
+	{
+		return {};
+	}
+	const char* apostrophe = strchr(spawn->Lastname, '\'');
+	if (!apostrophe)
+	{
+		return {};
+	}
+	return { spawn->Lastname, static_cast<size_t>(apostrophe - &spawn->Lastname[0]) };
+}
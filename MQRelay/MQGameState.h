@@ -0,0 +1,47 @@
+#pragma once
+#include "GameState.h"
+#include <mq/Plugin.h>
+
+//Reads the live client for Relay
+class MQGameState final : public GameStateProvider
+{
+public:
+	std::string_view ServerName() override;
+	std::string_view ZoneName() override;
+	std::string_view CharacterName() override;
+	std::string_view GroupLeaderName() override;
+
+	void ReadCharacterStats(CharacterStats& stats) override;
+	void ReadCharacterState(CharacterState& state) override;
+	size_t BuffSlotCount(BuffKind kind) override;
+	void ReadBuffSignature(BuffKind kind, size_t slot, BuffSignature& signature) override;
+	void ReadBuff(BuffKind kind, size_t slot, BuffState& buff) override;
+	size_t XTargetSlotCount() override;
+	bool ReadXTarget(size_t slot, XTargetState& xTarget) override;
+	bool ReadGroupRoles(GroupRoles& roles) override;
+
+	SpawnHandle FirstSpawn() override;
+	SpawnHandle NextSpawn(SpawnHandle spawn) override;
+	void ReadSpawn(SpawnHandle spawn, SpawnState& state) override;
+	unsigned ReadSpawnId(SpawnHandle spawn) override;
+	void ReadSpawnPosition(SpawnHandle spawn, SpawnPosition& position) override;
+	std::string_view ReadSpawnName(SpawnHandle spawn) override;
+	size_t ReadGroupPositions(GroupMemberPosition* members, size_t count) override;
+	uint64_t ReadMeleeRangeSignature(SpawnHandle spawn) override;
+	void ReadMeleeRanges(SpawnHandle spawn, float& maxRange, float& maxRangeTo) override;
+	size_t SpawnBuffCount(SpawnHandle spawn) override;
+	bool ReadSpawnBuff(SpawnHandle spawn, size_t index, SpawnBuffState& buff) override;
+
+	void ReportError(const char* message) override;
+
+	//The handle for a spawn the plugin callbacks were given
+	static SpawnHandle ToHandle(const PlayerClient* spawn) { return reinterpret_cast<SpawnHandle>(spawn); }
+
+private:
+	static std::string_view GetCombatState();
+	static int64_t GetPctHP(const PlayerClient* pSpawn);
+	static std::string_view GetOwnerName(const PlayerClient* spawn);
+	static PlayerClient* ToSpawn(SpawnHandle spawn) { return reinterpret_cast<PlayerClient*>(spawn); }  // NOLINT(performance-no-int-to-ptr)
+	char _characterName[MAX_STRING] = { 0 };
+	char _leaderName[MAX_STRING] = { 0 };
+};
@@ -5,7 +5,10 @@
 // are shown below. Remove the ones your plugin does not use.  Always use Initialize
 // and Shutdown for setup and cleanup.
 
+#include "MQGameState.h"
 #include "Relay.h"
+#include "RelaySettings.h"
+#include <filesystem>
 PreSetup("MQRelay");
 PLUGIN_VERSION(0.1);
 
@@ -13,19 +16,245 @@ PLUGIN_VERSION(0.1);
  * Avoid Globals if at all possible, since they persist throughout your program.
  * But if you must have them, here is the place to put them.
  */
-// bool ShowMQRelayWindow = true;
+bool ShowMQRelayWindow = false;
 /**
  * @fn InitializePlugin
  *
  * This is called once on plugin initialization and can be considered the startup
  * routine for the plugin.
  */
+MQGameState gameState;
 std::unique_ptr<Relay> relay;
 RelayTimings timings;
+RelayOptions options;
+
+//[Timings] and [Options] in MQRelay.ini, a key that's missing keeps its default
+static void LoadSettings()
+{
+	char value[MAX_STRING] = { 0 };
+	RelaySettings::ForEach([&](const char* section, const char* name) {
+		if (GetPrivateProfileString(section, name, "", value, MAX_STRING, INIFileName) > 0 && !RelaySettings::Set(name, value, timings, options))
+		{
+			WriteChatf("MQRelay: ignoring %s=%s in [%s] of %s", name, value, section, INIFileName);
+		}
+	});
+}
+
+static void PrintStats(RelayMetrics& metrics)
+{
+	WriteChatf("MQRelay stage timings in microseconds");
+	metrics.ForEachTimer([](const char* name, const LatencyHistogram& histogram) {
+		WriteChatf("  %s: p50 %llu p99 %llu max %llu (%llu samples)", name,
+			histogram.Percentile(50), histogram.Percentile(99), histogram.Max(), histogram.Count());
+	});
+	const auto batches = std::max<uint64_t>(metrics.Batches.Value(), 1);
+	WriteChatf("  %llu commands and %llu bytes over %llu batches, %llu commands and %llu bytes per batch",
+		metrics.Commands.Value(), metrics.Bytes.Value(), metrics.Batches.Value(),
+		metrics.Commands.Value() / batches, metrics.Bytes.Value() / batches);
+	WriteChatf("  %llu of %llu spawn fields sent", metrics.SpawnFieldsSent.Value(), metrics.SpawnsVisited.Value() * SpawnFieldCount);
+	WriteChatf("  %llu ticks, %llu coalesced, %llu dropped, %llu failed", metrics.Ticks.Value(),
+		metrics.CoalescedUpdates.Value(), metrics.DroppedBatches.Value(), metrics.FailedBatches.Value());
+}
+
+static void DrawStats(RelayMetrics& metrics)
+{
+	if (ImGui::BeginTable("MQRelayTimers", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn("Stage");
+		ImGui::TableSetupColumn("p50 (us)");
+		ImGui::TableSetupColumn("p99 (us)");
+		ImGui::TableSetupColumn("Max (us)");
+		ImGui::TableSetupColumn("Samples");
+		ImGui::TableHeadersRow();
+		metrics.ForEachTimer([](const char* name, const LatencyHistogram& histogram) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", histogram.Percentile(50));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", histogram.Percentile(99));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", histogram.Max());
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", histogram.Count());
+		});
+		ImGui::EndTable();
+	}
+	if (ImGui::BeginTable("MQRelayCounters", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		metrics.ForEachCounter([](const char* name, const Counter& counter) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", counter.Value());
+		});
+		ImGui::EndTable();
+	}
+	if (ImGui::Button("Reset"))
+	{
+		metrics.Reset();
+	}
+}
+
+/**
+ * ${Relay} reads the BlackboardMirror, it's NULL unless RelayOptions::Mirror is set.
+ * Nothing here goes to redis, so Lua can read it every frame
+ *   Blackboard[field]         a field of <server>:<leader>:blackboard
+ *   Character[name,field]     a field of a group member's character hash
+ *   Live                      whether the mirror is loaded and following the group's changes
+ *   Age                       milliseconds since the mirror last changed
+ */
+class MQ2RelayType : public MQ2Type
+{
+public:
+	enum class Members
+	{
+		Blackboard,
+		Character,
+		Live,
+		Age
+	};
+
+	MQ2RelayType() : MQ2Type("Relay")
+	{
+		ScopedTypeMember(Members, Blackboard);
+		ScopedTypeMember(Members, Character);
+		ScopedTypeMember(Members, Live);
+		ScopedTypeMember(Members, Age);
+	}
+
+	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
+	{
+		const auto* mirror = relay ? relay->Mirror() : nullptr;
+		const MQTypeMember* member = FindMember(Member);
+		if (!mirror || !member)
+		{
+			return false;
+		}
+		switch (static_cast<Members>(member->ID))
+		{
+		case Members::Blackboard:
+			if (!Index || !Index[0] || !mirror->GetBlackboard(Index, DataTypeTemp, MAX_STRING))
+			{
+				return false;
+			}
+			Dest.Ptr = &DataTypeTemp[0];
+			Dest.Type = mq::datatypes::pStringType;
+			return true;
+		case Members::Character:
+		{
+			//Name,Field
+			const std::string_view index = Index ? Index : "";
+			const auto comma = index.find(',');
+			if (comma == std::string_view::npos || !mirror->GetCharacter(index.substr(0, comma), index.substr(comma + 1), DataTypeTemp, MAX_STRING))
+			{
+				return false;
+			}
+			Dest.Ptr = &DataTypeTemp[0];
+			Dest.Type = mq::datatypes::pStringType;
+			return true;
+		}
+		case Members::Live:
+			Dest.Set(mirror->Live());
+			Dest.Type = mq::datatypes::pBoolType;
+			return true;
+		case Members::Age:
+		{
+			const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			const auto lastChange = mirror->LastChange();
+			Dest.Int64 = lastChange ? now - lastChange : -1;
+			Dest.Type = mq::datatypes::pInt64Type;
+			return true;
+		}
+		}
+		return false;
+	}
+
+	bool ToString(MQVarPtr VarPtr, char* Destination) override
+	{
+		const auto* mirror = relay ? relay->Mirror() : nullptr;
+		strcpy_s(Destination, MAX_STRING, mirror && mirror->Live() ? "TRUE" : "FALSE");
+		return true;
+	}
+};
+MQ2RelayType* pRelayType = nullptr;
+
+static bool RelayData(const char*, MQTypeVar& Dest)
+{
+	if (!relay || !relay->Mirror())
+	{
+		return false;
+	}
+	Dest.DWord = 1;
+	Dest.Type = pRelayType;
+	return true;
+}
+
+/**
+ * /relay stats [reset] prints or resets the relay's metrics
+ * /relay ui toggles the metrics window
+ */
+static void RelayCommand(PlayerClient*, const char* line)
+{
+	char arg[MAX_STRING] = { 0 };
+	GetArg(arg, line, 1);
+	if (ci_equals(arg, "ui"))
+	{
+		ShowMQRelayWindow = !ShowMQRelayWindow;
+		return;
+	}
+	if (ci_equals(arg, "stats") && relay)
+	{
+		GetArg(arg, line, 2);
+		if (ci_equals(arg, "reset"))
+		{
+			relay->Metrics().Reset();
+			WriteChatf("MQRelay: metrics reset");
+			return;
+		}
+		PrintStats(relay->Metrics());
+		WriteChatf("  %s", relay->IsZonePublisher() ? "Publishing every spawn in the zone" : "Another client is publishing this zone");
+		WriteChatf("  Spawn sweep budget %uus per update", relay->SpawnSweepBudget());
+		if (const auto error = relay->DirectiveError(); !error.empty())
+		{
+			WriteChatf("  Directive listener: %s", error.c_str());
+		}
+		if (const auto* mirror = relay->Mirror())
+		{
+			const auto error = mirror->LastError();
+			WriteChatf("  Mirror %s%s%s", mirror->Live() ? "live" : "not loaded", error.empty() ? "" : ", last error: ", error.c_str());
+		}
+		if (const auto error = relay->RecorderError(); !error.empty())
+		{
+			WriteChatf("  Recorder: %s", error.c_str());
+		}
+		return;
+	}
+	if (ci_equals(arg, "settings"))
+	{
+		//Read once when the plugin loaded, so this is what the running relay has
+		WriteChatf("MQRelay options from %s", INIFileName);
+		for (const auto& option : RelaySettings::Switches)
+		{
+			WriteChatf("  %s: %s", option.Name, options.*option.Field ? "on" : "off");
+		}
+		return;
+	}
+	WriteChatf("Usage: /relay stats [reset] | /relay settings | /relay ui");
+}
+
 PLUGIN_API void InitializePlugin()
 {
 	DebugSpewAlways("MQRelay::Initializing version %f", MQ2Version);
-	relay = std::make_unique<Relay>("tcp://localhost", timings);
+	//Recordings sit with the rest of MQ's logs
+	options.RecorderDirectory = (std::filesystem::path(gPathLogs) / "MQRelay").string();
+	LoadSettings();
+	relay = std::make_unique<Relay>("tcp://localhost", gameState, timings, options);
+	AddCommand("/relay", RelayCommand);
+	pRelayType = new MQ2RelayType;
+	AddMQ2Data("Relay", RelayData);
 	if (GetGameState() != GAMESTATE_INGAME)
 	{
 		return;
@@ -42,6 +271,10 @@ PLUGIN_API void InitializePlugin()
 PLUGIN_API void ShutdownPlugin()
 {
 	DebugSpewAlways("MQRelay::Shutting down");
+	RemoveCommand("/relay");
+	RemoveMQ2Data("Relay");
+	delete pRelayType;
+	pRelayType = nullptr;
 	relay = nullptr;
 }
 
@@ -122,6 +355,10 @@ PLUGIN_API void OnDrawHUD()
 PLUGIN_API void SetGameState(int GameState)
 {
 	// DebugSpewAlways("MQRelay::SetGameState(%d)", GameState);
+	if (relay && GameState != GAMESTATE_INGAME)
+	{
+		relay->OnLeaveGame();
+	}
 }
 
 
@@ -136,7 +373,16 @@ PLUGIN_API void SetGameState(int GameState)
  */
 PLUGIN_API void OnPulse()
 {
-	//relay->Update();
+	if (relay && GetGameState() == GAMESTATE_INGAME)
+	{
+		//Run straight away rather than delayed, the coordinator is waiting on them
+		static Directive directive;
+		while (relay->PopDirective(directive))
+		{
+			DoCommand(directive.Command.data(), false);
+		}
+		relay->Update();
+	}
 /*
 	static std::chrono::steady_clock::time_point PulseTimer = std::chrono::steady_clock::now();
 	// Run only after timer is up
@@ -209,6 +455,11 @@ PLUGIN_API bool OnIncomingChat(const char* Line, DWORD Color)
 PLUGIN_API void OnAddSpawn(PSPAWNINFO pNewSpawn)
 {
 	// DebugSpewAlways("MQRelay::OnAddSpawn(%s)", pNewSpawn->Name);
+	//Spawns added while zoning in are picked up by the arrival sweep
+	if (relay && GetGameState() == GAMESTATE_INGAME)
+	{
+		relay->OnAddSpawn(MQGameState::ToHandle(pNewSpawn));
+	}
 }
 
 /**
@@ -225,6 +476,10 @@ PLUGIN_API void OnAddSpawn(PSPAWNINFO pNewSpawn)
 PLUGIN_API void OnRemoveSpawn(PSPAWNINFO pSpawn)
 {
 	// DebugSpewAlways("MQRelay::OnRemoveSpawn(%s)", pSpawn->Name);
+	if (relay && GetGameState() == GAMESTATE_INGAME)
+	{
+		relay->OnRemoveSpawn(pSpawn->SpawnID);
+	}
 }
 
 /**
@@ -267,6 +522,10 @@ PLUGIN_API void OnRemoveGroundItem(PGROUNDITEM pGroundItem)
 PLUGIN_API void OnBeginZone()
 {
 	// DebugSpewAlways("MQRelay::OnBeginZone()");
+	if (relay)
+	{
+		relay->OnBeginZone();
+	}
 }
 
 /**
@@ -294,6 +553,10 @@ PLUGIN_API void OnEndZone()
 PLUGIN_API void OnZoned()
 {
 	// DebugSpewAlways("MQRelay::OnZoned()");
+	if (relay)
+	{
+		relay->OnZoned();
+	}
 }
 
 /**
@@ -307,23 +570,14 @@ PLUGIN_API void OnZoned()
  */
 PLUGIN_API void OnUpdateImGui()
 {
-/*
-	if (GetGameState() == GAMESTATE_INGAME)
+	if (ShowMQRelayWindow && relay)
 	{
-		if (ShowMQRelayWindow)
+		if (ImGui::Begin("MQRelay", &ShowMQRelayWindow))
 		{
-			if (ImGui::Begin("MQRelay", &ShowMQRelayWindow, ImGuiWindowFlags_MenuBar))
-			{
-				if (ImGui::BeginMenuBar())
-				{
-					ImGui::Text("MQRelay is loaded!");
-					ImGui::EndMenuBar();
-				}
-			}
-			ImGui::End();
+			DrawStats(relay->Metrics());
 		}
+		ImGui::End();
 	}
-*/
 }
 
 /**
@@ -0,0 +1,53 @@
+#include "PublisherElection.h"
+#include "Relay.h"
+#include "Sha1.h"
+
+PublisherElection::PublisherElection(const RelayTimings& timings)
+	: _timings(timings), _leaseScriptSHA(Sha1Hex(RelayScripts::PublisherLease)), _releaseScriptSHA(Sha1Hex(RelayScripts::PublisherRelease))
+{
+}
+
+void PublisherElection::SetLease(const std::string& leaseKey, const std::string& candidate)
+{
+	if (leaseKey == _leaseKey && candidate == _candidate)
+	{
+		return;
+	}
+	if (IsPublisher())
+	{
+		_releaseKey = _leaseKey;
+		_releaseCandidate = _candidate;
+	}
+	_leaseKey = leaseKey;
+	_candidate = candidate;
+	_generation++;
+	_results[_generation % 2].store(-1, std::memory_order_relaxed);
+	//Ask straight away, a zone nobody holds shouldn't go unpublished until the next renewal
+	_nextRequest = 0;
+}
+
+void PublisherElection::Update(RelayBatch& batch, long long time)
+{
+	if (!_releaseKey.empty())
+	{
+		batch.EvalSha(_releaseScriptSHA, _releaseKey, _releaseCandidate);
+		_releaseKey.clear();
+	}
+	if (_leaseKey.empty() || time < _nextRequest)
+	{
+		return;
+	}
+	batch.EvalSha(_leaseScriptSHA, _leaseKey, _candidate, _timings.PublisherLeaseTime);
+	batch.WatchReply(_results[_generation % 2]);
+	_nextRequest = time + _timings.PublisherLeaseRenewFrequency;
+}
+
+bool PublisherElection::IsPublisher() const
+{
+	return _results[_generation % 2].load(std::memory_order_relaxed) == 1;
+}
+
+bool PublisherElection::HasAnswer() const
+{
+	return _results[_generation % 2].load(std::memory_order_relaxed) >= 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "RelayBatch.h"
+#include <array>
+#include <atomic>
+#include <string>
+
+struct RelayTimings;
+
+//Decides which client publishes a zone's spawns.
+//Every client in the zone asks for a lease in redis, the holder keeps renewing it and everyone else keeps
+//asking, so when the holder leaves or stalls another client takes over as soon as the lease lapses.
+//The requests ride along in the normal batches and the worker hands back the answer, nothing here waits on redis
+class PublisherElection
+{
+public:
+	explicit PublisherElection(const RelayTimings& timings);
+	//Game thread. Switches to another zone's lease, giving up the old one if we held it
+	void SetLease(const std::string& leaseKey, const std::string& candidate);
+	//Game thread. Adds a lease request to the batch when one is due
+	void Update(RelayBatch& batch, long long time);
+	//What redis told us about the last request, false until the first answer arrives
+	[[nodiscard]] bool IsPublisher() const;
+	//Whether redis has answered for the current lease yet
+	[[nodiscard]] bool HasAnswer() const;
+
+private:
+	const RelayTimings& _timings;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	std::string _leaseKey;
+	std::string _candidate;
+	//A lease we held before the last SetLease, released on the next update
+	std::string _releaseKey;
+	std::string _releaseCandidate;
+	long long _nextRequest = 0;
+	//Answers for the current lease go in _results[_generation % 2], so a late answer about the zone we
+	//just left can't make us think we hold the new one. -1 until the answer arrives
+	std::array<std::atomic<long long>, 2> _results{};
+	unsigned _generation = 0;
+	std::string _leaseScriptSHA;
+	std::string _releaseScriptSHA;
+};
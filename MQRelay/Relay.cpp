@@ -1,403 +1,1151 @@
 #include "Relay.h"
+#include "Sha1.h"
 #include <sw/redis++/queued_redis.h>
-
-template<typename Func>
-long long measureTime(Func f) {
-	const auto start = std::chrono::high_resolution_clock::now();
-	f(); // Execute the function
-	const auto end = std::chrono::high_resolution_clock::now();
-
-	return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-}
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 
 void Relay::Update()
 {
+	ScopedTimer tickTimer(_metrics.Tick);
+	_metrics.Ticks.Add();
 	const auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	sw::redis::Pipeline pipe = _redis->pipeline(false);
-	if (time >= _characterStatsUpdateTime)
+	//A reset of the metrics starts the failure count over
+	_reportedFailures = std::min(_reportedFailures, _metrics.FailedBatches.Value());
+	if (const auto failed = _metrics.FailedBatches.Value(); failed > _reportedFailures && time >= _nextFailureReport)
+	{
+		char message[512] = { 0 };
+		snprintf(message, sizeof(message), "%llu updates failed to reach redis: %s", static_cast<unsigned long long>(failed - _reportedFailures), _worker->LastError().c_str());  // NOLINT(cert-err33-c)
+		_state.ReportError(message);
+		_reportedFailures = failed;
+		_nextFailureReport = time + 10000;
+	}
+	//A batch left over from last update is one the worker didn't have room for, this update is added on to it
+	if (!_batch)
+	{
+		_batch = _worker->Acquire();
+	}
+	auto& batch = *_batch;
+	//The worker lost updates it couldn't hold on to while redis was away
+	if (_worker->TakeResync())
+	{
+		Resync();
+	}
+	//Spawns whose write lost the script's arbitration, or whose hash had gone, are published in full next time they're due
+	_worker->TakeCollected(_lostSpawns);
+	for (const auto spawnId : _lostSpawns)
 	{
-		UpdateCharacterStats(pipe);
-		_characterStatsUpdateTime = time + _timings.CharacterStatsUpdateFrequency;
+		if (const auto shadow = _spawnShadows.find(static_cast<unsigned>(spawnId)); shadow != _spawnShadows.end())
+		{
+			shadow->second.NextFullPublish = 0;
+		}
+	}
+	_metrics.LostSpawnWrites.Add(_lostSpawns.size());
+	RefreshKeys();
+	//Walking the whole spawn list is the expensive part of the table, so it's only built again between sweeps,
+	//when one is about to start or at least every SpawnsUpdateFrequency. Every other update just refreshes it
+	if (!_sweep.Active && (time >= _spawnsUpdateTime || time >= _spawnsBuildTime))
+	{
+		_spawnsBuilt = false;
+		_spawnsBuildTime = time + _timings.SpawnsUpdateFrequency;
+	}
+	_spawnsRefreshed = false;
+	//Only timed when there's spawn work so idle ticks don't drown out the real cost
+	if (!_addedSpawns.empty() || !_removedSpawnKeys.Empty() || _sweep.Active || time >= _spawnsUpdateTime)
+	{
+		ScopedTimer snapshotTimer(_metrics.Snapshot);
+		UpdateSpawnLifecycle(batch, time);
+		if (_sweep.Active || time >= _spawnsUpdateTime)
+		{
+			if (!_sweep.Active)
+			{
+				//Often enough for the most frequent tier, each spawn is only read when its own tier is due.
+				//A sweep that takes longer than this starts the next one as soon as it finishes
+				_spawnsUpdateTime = time + std::min({ _timings.SpawnEngagedUpdateFrequency, _timings.SpawnNearUpdateFrequency,
+													   _timings.SpawnMovingUpdateFrequency, _timings.SpawnsUpdateFrequency });
+			}
+			UpdateSpawnData(batch, time);
+		}
 	}
-	if (time >= _characterStateUpdateTime)
 	{
-		UpdateCharacterState(pipe);
-		_characterStateUpdateTime = time + _timings.CharacterStateUpdateFrequency;
+		ScopedTimer serializeTimer(_metrics.Serialize);
+		//Every spawn published this update goes to redis as a single script call
+		FlushSpawnPayload(batch, time);
+		FlushSpatialIndex(batch);
+		if (time >= _characterStatsUpdateTime)
+		{
+			UpdateCharacterStats(batch, time);
+			_characterStatsUpdateTime = time + _timings.CharacterStatsUpdateFrequency;
+		}
+		if (time >= _characterStateUpdateTime)
+		{
+			UpdateCharacterState(batch, time);
+			_characterStateUpdateTime = time + _timings.CharacterStateUpdateFrequency;
+		}
+		if (time >= _xTargetsUpdateTime)
+		{
+			UpdateXTargetData(batch, time);
+			_xTargetsUpdateTime = time + _timings.XTargetUpdateFrequency;
+		}
+		if (time >= _buffsUpdateTime)
+		{
+			UpdateBuffData(time);
+			_buffsUpdateTime = time + _timings.BuffUpdateFrequency;
+		}
+		if (_options.GroupProximity && time >= _groupProximityUpdateTime)
+		{
+			UpdateGroupProximity();
+			_groupProximityUpdateTime = time + _timings.GroupProximityUpdateFrequency;
+		}
+		if (_options.PublisherElection)
+		{
+			_election.Update(batch, time);
+		}
+		if (time >= _zonePresenceTime)
+		{
+			UpdateZonePresence(batch, time);
+			_zonePresenceTime = time + _timings.ZonePresenceFrequency;
+		}
+		UpdateZoneCleanup(batch, time);
+		if (time >= _metricsUpdateTime)
+		{
+			UpdateMetrics(time);
+			_metricsUpdateTime = time + _timings.MetricsUpdateFrequency;
+		}
 	}
-	if (time >= _spawnsUpdateTime)
+	if (_options.Recorder && time >= _recorderUpdateTime)
 	{
-		UpdateSpawnData(pipe, time);
-		_spawnsUpdateTime = time + _timings.SpawnsUpdateFrequency;
+		UpdateRecorder(time);
+		_recorderUpdateTime = time + _timings.RecorderFrequency;
 	}
-	if (time >= _xTargetsUpdateTime)
+	if (batch.Empty() && _writes.Empty())
 	{
-		UpdateXTargetData(pipe, time);
-		_xTargetsUpdateTime = time + _timings.XTargetUpdateFrequency;
+		return;
 	}
-	if (time >= _buffsUpdateTime)
+	//A batch carried over keeps the time of the update that started it
+	if (batch.Started() == std::chrono::steady_clock::time_point())
 	{
-		UpdateBuffData(pipe);
-		_buffsUpdateTime = time + _timings.BuffUpdateFrequency;
+		batch.SetStarted(tickTimer.Started());
 	}
-	pipe.expire(GetCharacterKey(), _timings.CharacterExpireTime);
-	pipe.exec();
+	if (_options.Heartbeats)
+	{
+		_writes.HSet(_keys.Character, "StateVersion", ++_stateVersion);
+		batch.SetVersion(_stateVersion);
+	}
+	_writes.Expire(_keys.Character, _timings.CharacterExpireTime);
+	//Every key written this update gets one HSET and one EXPIRE, whichever updates wrote to it
+	_metrics.CoalescedWrites.Add(_writes.Flush(batch));
+
+	ScopedTimer enqueueTimer(_metrics.Enqueue);
+	const auto commands = batch.CommandCount();
+	const auto bytes = batch.Bytes();
+	if (_worker->TrySubmit(_batch))
+	{
+		_metrics.Batches.Add();
+		_metrics.Commands.Add(commands);
+		_metrics.Bytes.Add(bytes);
+		return;
+	}
+	//The worker is behind, rather than wait on it we keep building on this batch next update.
+	//If it has grown too big we give up on it, the shadows no longer match redis so everything is published again
+	_metrics.CoalescedUpdates.Add();
+	if (batch.CommandCount() > MaxBatchCommands)
+	{
+		batch.Clear();
+		Resync();
+		_metrics.DroppedBatches.Add();
+	}
+}
 
+void Relay::Resync()
+{
+	_spawnShadows.clear();
+	_statsChanges.Reset();
+	_stateChanges.Reset();
+	_characterStatsUpdateTime = 0;
+	_characterStateUpdateTime = 0;
+	_xTargetsUpdateTime = 0;
+	_buffsUpdateTime = 0;
+	_buffsExpireTime = 0;
+	_buffShadows.assign(_buffShadows.size(), {});
+	_songShadows.assign(_songShadows.size(), {});
+	_zoneSnapshotUpdateTime = 0;
 }
 
-void Relay::LoadSpellData(sw::redis::Pipeline& pipeline, const std::string& key, const EQ_Affect& buff) const
+void Relay::OnAddSpawn(SpawnHandle spawn)
 {
-	pipeline.hset(key, "SpellId", ToString(buff.SpellID ? buff.SpellID : -1));
+	_spawns.Add(spawn);
+	_addedSpawns.push_back(_state.ReadSpawnId(spawn));
+}
 
-	if (buff.SpellID > 0)
+void Relay::OnRemoveSpawn(unsigned spawnId)
+{
+	//Its slot is emptied rather than taken out, so the sweep carries on from where it was
+	_spawns.Remove(spawnId);
+	//Leaving the zone removes every spawn, they're still there for everyone else
+	if (_zoning)
 	{
-		pipeline.hset(key, "Duration", ToString(GetSpellBuffTimer(buff.SpellID)));
-		pipeline.hset(key, "CorruptionCounters", std::to_string(GetSpellCounters(SPA_CORRUPTION, buff)));
-		pipeline.hset(key, "CurseCounters", std::to_string(GetSpellCounters(SPA_CURSE, buff)));
-		pipeline.hset(key, "DiseaseCounters", std::to_string(GetSpellCounters(SPA_DISEASE, buff)));
-		pipeline.hset(key, "PoisonCounters", std::to_string(GetSpellCounters(SPA_POISON, buff)));
-		pipeline.hset(key, "HitCount", ToString(buff.HitCount));
+		return;
 	}
-	pipeline.expire(key, _timings.CharacterBuffExpireTime);
+	RefreshKeys();
+	const KeyBuffer key(_keys.SpawnBase, spawnId);
+	if (const auto shadow = _spawnShadows.find(spawnId); shadow != _spawnShadows.end())
+	{
+		if (shadow->second.Buffs)
+		{
+			_removedSpawnKeys.Add(KeyBuffer(key, ":buffs"));
+		}
+		_spawnShadows.erase(shadow);
+	}
+	_removedSpawnKeys.Add(key);
+	if (_options.ChangeStreams)
+	{
+		_removedSpawnIds.push_back(spawnId);
+	}
+	if (_options.SpatialIndex)
+	{
+		_gridRemovals.Add(spawnId);
+	}
+	_addedSpawns.erase(std::remove(_addedSpawns.begin(), _addedSpawns.end(), spawnId), _addedSpawns.end());
+}
+
+void Relay::OnBeginZone()
+{
+	_zoning = true;
+	_addedSpawns.clear();
+	if (_options.ZoneCleanup && _keys.Valid)
+	{
+		//Whatever is left of an earlier cleanup is given up on, it expires on its own
+		_zoneCleanup.Relays = _keys.Relays;
+		_zoneCleanup.Candidate = _keys.Character;
+		_zoneCleanup.Keys.Clear();
+		_zoneCleanup.Next = 0;
+		//Our XTargets were in the zone we're leaving, nobody else writes to them
+		for (const auto spawnId : _xTargetIds)
+		{
+			_zoneCleanup.Keys.Add(KeyBuffer(_keys.XTargetBase, spawnId));
+		}
+		_zoneCleanup.Owned = _zoneCleanup.Keys.Size();
+		//Every client in the zone writes these, the script only removes them if we were the last one there
+		for (const auto& [spawnId, shadow] : _spawnShadows)
+		{
+			const KeyBuffer key(_keys.SpawnBase, spawnId);
+			_zoneCleanup.Keys.Add(key);
+			if (shadow.Buffs)
+			{
+				_zoneCleanup.Keys.Add(KeyBuffer(key, ":buffs"));
+			}
+		}
+		_zoneCleanup.Keys.Add(_keys.Snapshot);
+		_zoneCleanup.Keys.Add(_keys.Grid);
+	}
+	_spawnShadows.clear();
+	_spawns.Clear();
+	_spawnsBuilt = false;
+	_removedSpawnIds.clear();
+	_gridAdds.Clear();
+	_gridRemovals.Clear();
+	//Nothing the sweep was walking survives the zone
+	_sweep.Active = false;
+	_sweep.Next = 0;
+	_targetId = 0;
+	_xTargetIds.clear();
+	_keys.Valid = false;
+}
+
+void Relay::OnZoned()
+{
+	_zoning = false;
+	_keys.Valid = false;
+	//Everything in the zone was just added, the arrival sweep publishes it within its budget instead
+	_addedSpawns.clear();
+	_arriving = true;
+	_arrivalDeadline = 0;
+	_spawnsUpdateTime = 0;
+	_zoneSnapshotUpdateTime = 0;
+	//Anyone leaving the zone needs to know we're here before they clean it up
+	_zonePresenceTime = 0;
 }
 
-void Relay::UpdateBuffData(sw::redis::Pipeline& pipeline) const
+void Relay::OnLeaveGame()
 {
-	const auto* characterInfo2 = GetPcProfile();
-	const std::string baseBuffKey = GetCharacterKey() + ":buffs:";
-	const std::string baseSongKey = GetCharacterKey() + ":songs:";
+	//We don't hear about spawns removed meanwhile, so none of the handles the table holds, or was about to add,
+	//can be trusted. It's built again before anything reads it
+	_spawns.Clear();
+	_spawnsBuilt = false;
+	//Our hashes can expire while we're away, and a spawn that comes back with an id we knew would otherwise only
+	//get the fields that differ from what we wrote before. Starting over publishes everything in full
+	Resync();
+	_sweep.Active = false;
+	_sweep.Next = 0;
+	_addedSpawns.clear();
+}
 
-	for (int i = 0; i < NUM_LONG_BUFFS; ++i)
+void Relay::UpdateZonePresence(RelayBatch& batch, long long time)
+{
+	//Every client adds itself whether or not it cleans up, so those that do know it's there
+	batch.Command("ZADD", _keys.Relays, time, _keys.Character);
+	batch.Command("EXPIRE", _keys.Relays, _timings.ZonePresenceTimeout / 1000 + 1);
+}
+
+void Relay::UpdateZoneCleanup(RelayBatch& batch, long long time)
+{
+	const size_t remaining = _zoneCleanup.Keys.Size() - _zoneCleanup.Next;
+	if (remaining == 0)
+	{
+		return;
+	}
+	//UNLINK frees the memory off redis' main thread, and the batches keep any one script call short
+	const size_t count = std::min<size_t>(remaining, std::max(_timings.ZoneCleanupBatchSize, 1U));
+	const size_t owned = _zoneCleanup.Owned > _zoneCleanup.Next ? std::min(count, _zoneCleanup.Owned - _zoneCleanup.Next) : 0;
+	batch.BeginCommand("EVALSHA");
+	batch.Arg(_zoneCleanupScriptSHA);
+	batch.Arg(count + 1);
+	batch.Arg(_zoneCleanup.Relays);
+	for (size_t i = 0; i < count; ++i)
+	{
+		batch.Arg(_zoneCleanup.Keys[_zoneCleanup.Next++]);
+	}
+	batch.Arg(_zoneCleanup.Candidate);
+	batch.Arg(owned);
+	batch.Arg(time);
+	batch.Arg(_timings.ZonePresenceTimeout);
+	if (_zoneCleanup.Next == _zoneCleanup.Keys.Size())
 	{
-		auto buffKey = baseBuffKey + std::to_string(i);
+		_zoneCleanup.Keys.Clear();
+		_zoneCleanup.Owned = 0;
+		_zoneCleanup.Next = 0;
+	}
+}
 
-		const auto& buff = characterInfo2->GetEffect(i);
-		LoadSpellData(pipeline, buffKey, buff);
+void Relay::PublishBuff(const sw::redis::StringView& key, const BuffState& buff, long long time)
+{
+	_metrics.BuffSlotsSent.Add();
+	if (buff.SpellId <= 0)
+	{
+		_writes.HSet(key, "SpellId", -1);
+		return;
 	}
-	for (int i = 0; i < NUM_SHORT_BUFFS; ++i)
+	//Duration is only right when it was written, Expires stays right for as long as the buff isn't refreshed
+	//so readers should count down from that. Buffs that don't wear off have no expiry
+	const long long expires = buff.Duration > 0 ? time + buff.Duration : -1;
+	_writes.HSet(key, "SpellId", buff.SpellId);
+	_writes.HSet(key, "Duration", buff.Duration);
+	_writes.HSet(key, "Expires", expires);
+	_writes.HSet(key, "CorruptionCounters", buff.CorruptionCounters);
+	_writes.HSet(key, "CurseCounters", buff.CurseCounters);
+	_writes.HSet(key, "DiseaseCounters", buff.DiseaseCounters);
+	_writes.HSet(key, "PoisonCounters", buff.PoisonCounters);
+	_writes.HSet(key, "HitCount", buff.HitCount);
+}
+
+void Relay::UpdateBuffSlots(BuffKind kind, const std::vector<std::string>& keys, std::vector<BuffShadow>& shadows, long long time, bool refreshExpiry)
+{
+	BuffSignature signature;
+	BuffState buff;
+	for (size_t i = 0; i < keys.size(); ++i)
 	{
-		auto songKey = baseSongKey + std::to_string(i);
+		auto& shadow = shadows[i];
+		_state.ReadBuffSignature(kind, i, signature);
+		//A buff counting down is already described by its Expires, anything else is worth sending
+		const bool unchanged = shadow.Published && signature.SpellId == shadow.Signature.SpellId &&
+							   signature.Fingerprint == shadow.Signature.Fingerprint && signature.Remaining <= shadow.Signature.Remaining;
+		if (!unchanged)
+		{
+			_state.ReadBuff(kind, i, buff);
+			PublishBuff(keys[i], buff, time);
+			shadow.Published = true;
+		}
+		shadow.Signature = signature;
+		if (refreshExpiry)
+		{
+			_writes.Expire(keys[i], _timings.CharacterBuffExpireTime);
+		}
+	}
+}
 
-		const auto& buff = characterInfo2->GetTempEffect(i);
-		LoadSpellData(pipeline, songKey, buff);
+void Relay::UpdateBuffData(long long time)
+{
+	//Halfway through the expiry is often enough that a slot never lapses while we're still around
+	const bool refreshExpiry = time >= _buffsExpireTime;
+	if (refreshExpiry)
+	{
+		_buffsExpireTime = time + _timings.CharacterBuffExpireTime * 1000LL / 2;
 	}
+	UpdateBuffSlots(BuffKind::Buff, _keys.Buffs, _buffShadows, time, refreshExpiry);
+	UpdateBuffSlots(BuffKind::Song, _keys.Songs, _songShadows, time, refreshExpiry);
 }
 
-void Relay::UpdateCharacterState(sw::redis::Pipeline& pipeline)
+void Relay::UpdateCharacterState(RelayBatch& batch, long long time)
 {
-	const std::string key = GetCharacterKey();
-	const auto targetId = pTarget ? pTarget->SpawnID : 0;
-	pipeline.hset(key, "CurrentHP", std::to_string(GetCurHPS()));
-	pipeline.hset(key, "CurrentMana", std::to_string(GetCurMana()));
-	pipeline.hset(key, "CurrentEndurance", std::to_string(GetCurEndurance()));
-	pipeline.hset(key, "CombatState", GetCombatState());
-	pipeline.hset(key, "Casting", std::to_string(pLocalPlayer->CastingData.SpellID));
-	pipeline.hset(key, "CastingTargetId", std::to_string(pLocalPlayer->CastingData.TargetID));
-	pipeline.hset(key, "CastingETA", std::to_string(pLocalPlayer->CastingData.SpellETA));
-	pipeline.hset(key, "AutoAttacking", std::to_string(pEverQuestInfo->bAutoAttack));
-	pipeline.hset(key, "AutoFiring", std::to_string(pEverQuestInfo->bAutoRangeAttack != 0));
-	pipeline.hset(key, "Heading", std::to_string(pLocalPlayer->Heading * 0.703125f));
-	pipeline.hset(key, "TargetId", std::to_string(targetId));
-	pipeline.hset(key, "PctAggro", ToString(pAggroInfo->aggroData[AD_Player].AggroPct));
+	CharacterState state;
+	_state.ReadCharacterState(state);
+	_stateChanges.Begin();
+	const auto set = [&](const char* field, const auto& value) { SetCharacterField(_stateChanges, field, value); };
+	set("CurrentHP", state.CurrentHP);
+	set("CurrentMana", state.CurrentMana);
+	set("CurrentEndurance", state.CurrentEndurance);
+	set("CombatState", state.CombatState);
+	set("Casting", state.CastingSpellId);
+	set("CastingTargetId", state.CastingTargetId);
+	set("CastingETA", state.CastingETA);
+	set("AutoAttacking", state.AutoAttacking);
+	set("AutoFiring", state.AutoFiring);
+	//Six decimals is what std::to_string wrote, consumers already parse these
+	set("Heading", Fixed{ state.Heading, 6 });
+	set("TargetId", state.TargetId);
+	_targetId = state.TargetId;
+	set("PctAggro", state.PctAggro);
 
-	pipeline.hset(key, "X", std::to_string(pLocalPlayer->X));
-	pipeline.hset(key, "Y", std::to_string(pLocalPlayer->Y));
-	pipeline.hset(key, "Z", std::to_string(pLocalPlayer->Z));
+	set("X", Fixed{ state.X, 6 });
+	set("Y", Fixed{ state.Y, 6 });
+	set("Z", Fixed{ state.Z, 6 });
+	FlushCharacterChanges(batch, _stateChanges, time);
 
-	if (targetId > 0)
+	if (state.TargetId > 0)
 	{
-		const char* serverShortName = GetServerShortName();
-		const char* zoneShortname = pZoneInfo->ShortName;
-		std::ostringstream oss;
-		oss << serverShortName << ":" << zoneShortname << ":spawns:" << targetId;
-		const std::string spawnKey = oss.str();
+		const KeyBuffer spawnKey(_keys.SpawnBase, state.TargetId);
 
 		//TODO: These may need a script to prevent constant updating from multiple clients
-		pipeline.hset(spawnKey, "TargetOfTarget", ToString(pLocalPlayer->TargetOfTarget));
-		pipeline.hset(spawnKey, "SecondaryAggroId", ToString(pAggroInfo->AggroSecondaryID));
-		pipeline.hset(spawnKey, "SecondaryAggroPct", ToString(pAggroInfo->aggroData[AD_Secondary].AggroPct));
+		_writes.HSet(spawnKey, "TargetOfTarget", state.TargetOfTarget);
+		_writes.HSet(spawnKey, "SecondaryAggroId", state.SecondaryAggroId);
+		_writes.HSet(spawnKey, "SecondaryAggroPct", state.SecondaryAggroPct);
 	}
 }
 
-void Relay::UpdateSpawnData(sw::redis::Pipeline& pipeline, long long time) const
+SpawnTable& Relay::Spawns()
 {
-	//we did everything we could think of to speed up this loop. Each loop of gathering the data takes 0.01ms and the sending to the pipeline takes about the same
-	//we don't use the std::to_string here because in total it saved us about 4ms for a full loop of 600
-	auto* spawn = pSpawnManager->FirstSpawn;
-	const char* serverShortName = GetServerShortName();
-	const char* zoneShortname = pZoneInfo->ShortName;
-	std::ostringstream oss;
-	oss << serverShortName << ":" << zoneShortname << ":spawns:";
-	std::string baseKey = oss.str();
-
-	auto expirationTime = ToString(_timings.SpawnExpireTime);
-	auto timeString = std::to_string(time);
-
-	//These are just for profiling
-	//TODO: start profiling code
-	sw::redis::StringView x;
-	char yBuffer[64] = { 0 };
-	sw::redis::StringView y;
-	long long xTime = 0;
-	long long yTime = 0;
-	long long spawnCount = 0;
-	//TODO: end profiling code
-	while (spawn)
+	if (!_spawnsBuilt || !_spawnsRefreshed)
 	{
-		spawnCount++;
-		std::string key = baseKey + ToString(spawn->SpawnID);
-
-		unsigned ownerId = 0;
-
-		if (spawn->Mercenary)
+		ScopedTimer spawnsTimer(_metrics.Spawns);
+		if (_spawnsBuilt)
 		{
-			size_t pos = strchr(spawn->Lastname, '\'') - &spawn->Lastname[0];
-			strncpy_s(DataTypeTemp, spawn->Lastname, pos);
-
-			DataTypeTemp[pos] = 0;
+			_spawns.Refresh();
+		}
+		else
+		{
+			_spawns.Build();
+		}
+		_spawnsBuilt = true;
+		_spawnsRefreshed = true;
+	}
+	return _spawns;
+}
 
-			if (SPAWNINFO* pOwner = GetSpawnByName(DataTypeTemp))
+void Relay::UpdateSpawnData(RelayBatch& batch, long long time)
+{
+	//we did everything we could think of to speed up this loop. Each loop of gathering the data takes 0.01ms and the sending to the pipeline takes about the same
+	//values are formatted with std::to_chars straight into the payload, nothing in here allocates once the buffers have grown to fit the zone
+	if (!_sweep.Active)
+	{
+		if (_arriving)
+		{
+			if (!_arrivalDeadline)
 			{
-				ownerId = pOwner->SpawnID;
+				_arrivalDeadline = time + _timings.PublisherLeaseRenewFrequency;
 			}
-		}
-
-		//These are just for profiling
-		//TODO: start of profiling code
-		xTime += measureTime([&]() {
-			x = sw::redis::StringView(ToString(spawn->X, 2));
-			});
-
-		yTime += measureTime([&]() {
-			snprintf(yBuffer, sizeof(yBuffer), "%.*f", 2, spawn->Y);  // NOLINT(cert-err33-c)
-			y = sw::redis::StringView(yBuffer);
-			});
-
-		//TODO: End of profiling code
-		pipeline.evalsha(_spawnScriptSHA, { key }, { sw::redis::StringView(timeString),
-			sw::redis::StringView(ToString(GetDistanceSquared(pControlledPlayer,spawn),2)),
-			sw::redis::StringView(expirationTime),
-			sw::redis::StringView("Class"),sw::redis::StringView(ToString(spawn->GetClass())),
-			sw::redis::StringView("Type"),sw::redis::StringView(ToString(GetSpawnType(spawn))),
-			sw::redis::StringView("Name"),sw::redis::StringView(spawn->Name),
-			sw::redis::StringView("Heading"),sw::redis::StringView(ToString(spawn->Heading * 0.703125f,2)),
-			sw::redis::StringView("Level"),sw::redis::StringView(ToString(spawn->Level)),
-			sw::redis::StringView("Mark"),sw::redis::StringView(ToString(GetNPCMarkNumber(spawn))),
-			sw::redis::StringView("MasterId"),sw::redis::StringView(ToString(spawn->MasterID)),
-			sw::redis::StringView("OwnerId"),sw::redis::StringView(ToString(ownerId)),
-			sw::redis::StringView("PetId"),sw::redis::StringView(ToString(spawn->PetID)),
-			sw::redis::StringView("MaxRange"),sw::redis::StringView(ToString(GetMeleeRange(spawn,pControlledPlayer),2)),
-			sw::redis::StringView("MaxRangeTo"),sw::redis::StringView(ToString(GetMeleeRange(pControlledPlayer,spawn),2)),
-			sw::redis::StringView("Speed"),sw::redis::StringView(ToString(FindSpeed(spawn),2)),
-			sw::redis::StringView("Stunned"),sw::redis::StringView(ToString((spawn->PlayerState & 0x20) != 0)),
-			sw::redis::StringView("Targetable"),sw::redis::StringView(ToString(spawn->Targetable)),
-			sw::redis::StringView("X"),x,
-			sw::redis::StringView("Y"),y,
-			sw::redis::StringView("Z"),sw::redis::StringView(ToString(spawn->Z,2)) });
-		if (const int count = GetCachedBuffCount(spawn))
-		{
-
-			for (int i = 0; i < count; ++i)
+			if (_options.PublisherElection && !_election.HasAnswer() && time < _arrivalDeadline)
 			{
-				auto buffSlot = GetCachedBuffAt(spawn, i);
-				auto buffKey = key + ":buffs:" + ToString(buffSlot);
-				auto cachedBuff = GetCachedBuffAtSlot(spawn, buffSlot);
-				if (!cachedBuff)
-				{
-					continue;
-				}
-				pipeline.evalsha(_spawnBuffScriptSHA, { buffKey }, {
-					ToString(cachedBuff->Staleness()),
-					timeString,
-					ToString(cachedBuff->spellId),
-					cachedBuff->casterName,
-					ToString(cachedBuff->Duration())
-					});
+				//Look again next update rather than after the usual wait
+				_spawnsUpdateTime = 0;
+				return;
 			}
+			_arriving = false;
+			_sweep.Arrival = true;
+		}
+		const bool publisher = IsZonePublisher();
+		//Another client has the whole zone covered and we aren't filling in around ourselves either
+		if (!publisher && _options.NonPublisherRange <= 0)
+		{
+			_spawnShadows.clear();
+			return;
+		}
+		_sweep.Active = true;
+		_sweep.Next = 0;
+		_sweep.Start = time;
+		_sweep.Publisher = publisher;
+		//The snapshot is the whole zone, so only the publisher writes it and every spawn is read when it does
+		_sweep.ZoneSnapshot = _options.ZoneSnapshot && publisher && time >= _zoneSnapshotUpdateTime;
+		if (_sweep.ZoneSnapshot)
+		{
+			_zoneSnapshot.Begin(time);
+			_zoneSnapshotUpdateTime = time + _timings.ZoneSnapshotUpdateFrequency;
 		}
-		spawn = spawn->GetNext();
 	}
-	//avoiding divide by 0
-	spawnCount = spawnCount ? spawnCount : 1;
-	WriteChatColorf("x->ToString(spawn->X) took %lld an average of %f", CONCOLOR_LIGHTBLUE, xTime, xTime / spawnCount);
-	WriteChatColorf("buffered y took %lld an average of %f", CONCOLOR_LIGHTBLUE, yTime, yTime / spawnCount);
+
+	//0 is no budget, the sweep runs to the end
+	const unsigned budget = _sweep.Arrival ? _timings.ZoneArrivalSweepBudget : _sweep.Budget;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(budget);
+	uint64_t spawnCount = 0;
+	SpawnState state;
+	auto& spawns = Spawns();
+	size_t index = _sweep.Next;
+	while (index < spawns.Size())
+	{
+		const auto current = index++;
+		if (!spawns.Handle(current))
+		{
+			continue;
+		}
+		const float distance = spawns.Distance(current);
+		if (!ShouldPublish(_sweep.Publisher, distance))
+		{
+			continue;
+		}
+		const bool due = _options.SpawnHashes && IsSpawnDue(spawns.Id(current), distance, time);
+		if (!due && !_sweep.ZoneSnapshot)
+		{
+			continue;
+		}
+		spawnCount++;
+		spawns.Read(current, state);
+		if (due)
+		{
+			PublishSpawn(spawns.Handle(current), state, time);
+		}
+		if (_sweep.ZoneSnapshot)
+		{
+			AddToZoneSnapshot(state);
+		}
+		//Only spawns we actually read count against the budget, skipping one is a couple of loads
+		if (budget && std::chrono::steady_clock::now() >= deadline)
+		{
+			break;
+		}
+	}
+	_metrics.SpawnsVisited.Add(spawnCount);
+	_sweep.Next = index;
+	if (index >= spawns.Size())
+	{
+		FinishSpawnSweep(batch, time);
+	}
 }
 
-void Relay::UpdateCharacterStats(sw::redis::Pipeline& pipeline)
+void Relay::FinishSpawnSweep(RelayBatch& batch, long long time)
 {
-	const std::string key = GetCharacterKey();
-	// Queue Redis commands using the pipeline
-	pipeline.hset(key, "SpawnId", std::to_string(pLocalPlayer->SpawnID));
-	pipeline.hset(key, "MaxHP", std::to_string(GetMaxHPS()));
-	pipeline.hset(key, "MaxMana", std::to_string(GetMaxMana()));
-	pipeline.hset(key, "MaxEndurance", std::to_string(GetMaxEndurance()));
-	pipeline.hset(key, "Level", std::to_string(pLocalPlayer->Level));
-	pipeline.hset(key, "PctExp", std::to_string(static_cast<float>(pLocalPC->Exp) / EXP_TO_PCT_RATIO));
-	pipeline.hset(key, "PctAAExp", std::to_string(static_cast<float>(pLocalPC->AAExp) / EXP_TO_PCT_RATIO));
-	pipeline.hset(key, "Class", std::to_string(pLocalPlayer->GetClass()));
-	pipeline.hset(key, "Zone", pZoneInfo->ShortName);
-	pipeline.hset(key, "GroupLeader", GetLeaderName());
-}
-
-void Relay::UpdateXTargetData(sw::redis::Pipeline& pipeline, const long long time) const
-{
-	const auto key = GetCharacterKey() + ":XTargets:";
-	const std::string serverShortName = GetServerShortName();
-	const std::string zoneShortname = pZoneInfo->ShortName;
-	const std::string baseSpawnKey = serverShortName + ":" + zoneShortname + ":spawns:";
-	const auto expirationTime = ToString(_timings.SpawnExpireTime);
-	const auto timeString = std::to_string(time);
-	const auto xManager = GetCharInfo()->pXTargetMgr;
-	if (!xManager || !xManager->XTargetSlots.Count)
+	if (_sweep.ZoneSnapshot)
 	{
-		return;
+		batch.Set(_keys.Snapshot, _zoneSnapshot.Finish(), _timings.SpawnExpireTime);
 	}
-	for (auto i = 0; i < xManager->XTargetSlots.Count; i++)
+
+	//Anything we didn't see this sweep has left the zone without us hearing about it
+	for (auto it = _spawnShadows.begin(); it != _spawnShadows.end();)
 	{
-		if (const auto [xTargetType, XTargetSlotStatus, spawnId, _] = xManager->XTargetSlots[i]; xTargetType && XTargetSlotStatus)
+		if (it->second.LastSeen >= _sweep.Start)
 		{
-			auto currentKey = key + std::to_string(spawnId);
-			auto spawnKey = baseSpawnKey + std::to_string(spawnId);
-			const auto spawn = GetSpawnByID(spawnId);
-			pipeline.hset(currentKey, "AggroPercentage", ToString(pAggroInfo->aggroData[AD_xTarget1 + i].AggroPct));
-			pipeline.hset(currentKey, "Type", pLocalPC->pXTargetMgr->ExtendedTargetRoleName(xTargetType));
-			pipeline.hset(currentKey, "HeadingTo", pLocalPC->pXTargetMgr->ExtendedTargetRoleName(xTargetType));
-			pipeline.hset(currentKey, "LineOfSight", std::to_string(pControlledPlayer->CanSee(*spawn)));
-			pipeline.expire(currentKey, _timings.XTargetExpireTime);
+			++it;
+			continue;
+		}
+		if (it->second.Indexed)
+		{
+			_gridRemovals.Add(it->first);
+		}
+		it = _spawnShadows.erase(it);
+	}
 
-			//This updates the spawn, not the XTarget
-			pipeline.evalsha(_spawnHPScriptSHA, { spawnKey },
-							 {
-								 sw::redis::StringView(timeString),
-								 sw::redis::StringView(ToString(1)),
-								 sw::redis::StringView(expirationTime),
-								 std::to_string(GetPctHP(GetSpawnByID(spawnId)))
-							 });
+	//Only the publisher has seen every spawn in the zone, anyone else would take out spawns it's too far from
+	if (_options.SpatialIndex && _sweep.Publisher && time >= _gridPruneTime)
+	{
+		PruneSpatialIndex(batch);
+		_gridPruneTime = time + _timings.SpatialPruneFrequency;
+	}
+
+	//Spend more of each update when sweeps take too long and give it back when they finish well early
+	if (_timings.SpawnSweepTargetPeriod && _sweep.Budget && !_sweep.Arrival)
+	{
+		const auto period = time - _sweep.Start;
+		if (period > _timings.SpawnSweepTargetPeriod)
+		{
+			_sweep.Budget = std::min(_sweep.Budget + _sweep.Budget / 4, _timings.SpawnSweepMaxBudget);
+		}
+		else if (period < _timings.SpawnSweepTargetPeriod / 2)
+		{
+			_sweep.Budget = std::max(_sweep.Budget - _sweep.Budget / 5, _timings.SpawnSweepMinBudget);
 		}
 	}
+	_sweep.Active = false;
+	_sweep.Arrival = false;
+	_metrics.SpawnSweeps.Add();
 }
 
-void Relay::UpdateGroupData(sw::redis::Pipeline& pipeline) const
+void Relay::PruneSpatialIndex(RelayBatch& batch)
 {
-	//If we're grouped
-	if (pLocalPC->Group != nullptr && pLocalPC->Group->IsGroupLeader(pLocalPC->me))
+	//A spawn that arrives after this sweep read the table and is indexed by someone else can be taken out too,
+	//its publisher indexes it again at its next full publish
+	auto& spawns = Spawns();
+	batch.BeginCommand("EVALSHA");
+	batch.Arg(_gridPruneScriptSHA);
+	batch.Arg(1);
+	batch.Arg(_keys.Grid);
+	for (size_t i = 0; i < spawns.Size(); ++i)
 	{
-		const std::string serverName = GetServerShortName();
-		const auto groupKey = serverName + ":" + GetLeaderName();
-		CGroupMember* groupPuller = pLocalPC->Group->GetGroupMemberByRole(GroupRolePuller);
-		CGroupMember* groupAssist = pLocalPC->Group->GetGroupMemberByRole(GroupRoleAssist);
-		CGroupMember* groupTank = pLocalPC->Group->GetGroupMemberByRole(GroupRoleTank);
-		CGroupMember* groupLooter = pLocalPC->Group->GetGroupMemberByRole(GroupRoleMasterLooter);
-		CGroupMember* groupMarker = pLocalPC->Group->GetGroupMemberByRole(GroupRoleMarkNPC);
-		pipeline.hset(groupKey, "Puller ", ToString(groupPuller ? groupPuller->pSpawn->SpawnID : 0));
-		pipeline.hset(groupKey, "Assist", ToString(groupAssist ? groupAssist->pSpawn->SpawnID : 0));
-		pipeline.hset(groupKey, "Tank", ToString(groupTank ? groupTank->pSpawn->SpawnID : 0));
-		pipeline.hset(groupKey, "Looter", ToString(groupLooter ? groupLooter->pSpawn->SpawnID : 0));
-		pipeline.hset(groupKey, "Marker", ToString(groupMarker? groupMarker->pSpawn->SpawnID : 0));
-		pipeline.expire(groupKey, _timings.GroupExpireTime);
+		if (spawns.Handle(i))
+		{
+			batch.Arg(spawns.Id(i));
+		}
 	}
 }
 
-std::string Relay::GetCombatState()
+void Relay::UpdateSpawnLifecycle(RelayBatch& batch, long long time)
 {
-	switch (pPlayerWnd->CombatState)
+	batch.Unlink(_removedSpawnKeys);
+	_removedSpawnKeys.Clear();
+	for (const auto spawnId : _removedSpawnIds)
+	{
+		batch.Command("XADD", _keys.ZoneChanges, "MAXLEN", "~", _timings.ChangeStreamMaxLength, "*",
+					  "Key", KeyBuffer(_keys.SpawnBase, spawnId), "Time", time, "Removed", 1);
+	}
+	_removedSpawnIds.clear();
+
+	if (!_options.SpawnHashes)
+	{
+		_addedSpawns.clear();
+		return;
+	}
+	if (_addedSpawns.empty())
+	{
+		return;
+	}
+	auto& spawns = Spawns();
+	SpawnState state;
+	const bool publisher = IsZonePublisher();
+	for (const auto spawnId : _addedSpawns)
 	{
-	case eCombatState_Combat:
-		if (pPlayerWnd->GetChildItem("PW_CombatStateAnim"))
+		//It may have come and gone before we got here
+		if (const auto index = spawns.Find(spawnId); index < spawns.Size() && ShouldPublish(publisher, spawns.Distance(index)))
 		{
-			return "COMBAT";
+			_spawnShadows.erase(spawnId);
+			spawns.Read(index, state);
+			PublishSpawn(spawns.Handle(index), state, time);
 		}
-		return "NULL";
+	}
+	_addedSpawns.clear();
+}
 
-	case eCombatState_Debuff:
-		return "DEBUFFED";
+void Relay::FlushSpawnPayload(RelayBatch& batch, long long time)
+{
+	if (_spawnPayload.Empty())
+	{
+		return;
+	}
+	batch.BeginCommand("EVALSHA");
+	batch.Arg(_spawnBulkScriptSHA);
+	if (_options.ChangeStreams)
+	{
+		batch.Arg(2);
+		batch.Arg(_keys.SpawnBase);
+		batch.Arg(_keys.ZoneChanges);
+	}
+	else
+	{
+		batch.Arg(1);
+		batch.Arg(_keys.SpawnBase);
+	}
+	batch.Arg(time);
+	batch.Arg(_timings.SpawnExpireTime);
+	batch.Arg(_timings.ChangeStreamMaxLength);
+	batch.Args(_spawnPayload);
+	batch.CollectReply();
+	_spawnPayload.Clear();
+}
 
-	case eCombatState_Timer:
-		return "COOLDOWN";
+void Relay::FlushSpatialIndex(RelayBatch& batch)
+{
+	if (_gridAdds.Empty() && _gridRemovals.Empty())
+	{
+		return;
+	}
+	if (!_gridRemovals.Empty())
+	{
+		batch.BeginCommand("ZREM");
+		batch.Arg(_keys.Grid);
+		batch.Args(_gridRemovals);
+		_gridRemovals.Clear();
+	}
+	if (!_gridAdds.Empty())
+	{
+		batch.BeginCommand("ZADD");
+		batch.Arg(_keys.Grid);
+		batch.Args(_gridAdds);
+		_gridAdds.Clear();
+	}
+	//Every spawn in it is indexed again at least every SpawnFullPublishFrequency, which keeps this alive
+	_writes.Expire(_keys.Grid, _timings.SpawnExpireTime);
+}
 
-	case eCombatState_Standing:
-		return "ACTIVE";
+void Relay::AddToZoneSnapshot(const SpawnState& spawn)
+{
+	ZoneSnapshot::SpawnRecord record;
+	record.SpawnId = spawn.SpawnId;
+	record.MasterId = spawn.MasterId;
+	record.OwnerId = spawn.OwnerId;
+	record.PetId = spawn.PetId;
+	record.X = spawn.X;
+	record.Y = spawn.Y;
+	record.Z = spawn.Z;
+	record.Heading = spawn.Heading;
+	record.Distance = spawn.Distance;
+	record.Speed = spawn.Speed;
+	record.MaxRange = spawn.MaxRange;
+	record.MaxRangeTo = spawn.MaxRangeTo;
+	record.Level = static_cast<uint8_t>(spawn.Level);
+	record.Class = static_cast<uint8_t>(spawn.Class);
+	record.Type = static_cast<uint8_t>(spawn.Type);
+	record.Mark = static_cast<uint8_t>(spawn.Mark);
+	record.Flags = (spawn.Stunned ? ZoneSnapshot::Stunned : 0) | (spawn.Targetable ? ZoneSnapshot::Targetable : 0);
+	_zoneSnapshot.Add(record, spawn.Name);
+}
 
-	case eCombatState_Regen:
-		return "RESTING";
+unsigned Relay::SpawnUpdateFrequency(unsigned spawnId, float distance, bool moving) const
+{
+	if (spawnId == _targetId || std::find(_xTargetIds.begin(), _xTargetIds.end(), spawnId) != _xTargetIds.end())
+	{
+		return _timings.SpawnEngagedUpdateFrequency;
+	}
+	//Distance is squared
+	if (distance <= _options.SpawnNearRange * _options.SpawnNearRange)
+	{
+		return _timings.SpawnNearUpdateFrequency;
+	}
+	return moving ? _timings.SpawnMovingUpdateFrequency : _timings.SpawnsUpdateFrequency;
+}
 
-	default:
-		char buffer[MAX_STRING] = { 0 };
-		sprintf_s(buffer, "UNKNOWN(%d)", pPlayerWnd->CombatState);// NOLINT(cert-err33-c)
-		return buffer;
+bool Relay::IsSpawnDue(unsigned spawnId, float distance, long long time)
+{
+	const auto shadow = _spawnShadows.find(spawnId);
+	if (shadow == _spawnShadows.end())
+	{
+		return true;
 	}
+	shadow->second.LastSeen = time;
+	//The tier is worked out every pass so a spawn that walks up to us or gets pulled is due straight away
+	return time >= shadow->second.LastUpdate + SpawnUpdateFrequency(spawnId, distance, shadow->second.Moving);
 }
 
-std::string Relay::ToString(int value) {
-	char buffer[11]; // Enough to hold all digits of an int
-	snprintf(buffer, sizeof(buffer), "%d", value); // NOLINT(cert-err33-c)
-	return std::string(buffer);
+bool Relay::IsZonePublisher() const
+{
+	return !_options.PublisherElection || _election.IsPublisher();
 }
 
-std::string Relay::ToString(unsigned int value) {
-	char buffer[11]; // Maximum length of unsigned int representation + 1 for null-terminator
-	snprintf(buffer, sizeof(buffer), "%u", value); // NOLINT(cert-err33-c)
-	return std::string(buffer);
+bool Relay::ShouldPublish(bool publisher, float distance) const
+{
+	//Distance is squared
+	return publisher || distance <= _options.NonPublisherRange * _options.NonPublisherRange;
 }
 
-std::string Relay::ToString(uint8_t value) {
-	char buffer[4]; // A buffer of 4 is enough for any value 0-255 and the null terminator
-	snprintf(buffer, sizeof(buffer), "%u", value); // NOLINT(cert-err33-c)
-	return std::string(buffer);
+void Relay::PublishSpawn(SpawnHandle spawn, const SpawnState& state, long long time)
+{
+	static constexpr const char* fieldNames[SpawnFieldCount] = {
+		"Class", "Type", "Name", "Heading", "Level", "Mark", "MasterId", "OwnerId", "PetId",
+		"MaxRange", "MaxRangeTo", "Speed", "Stunned", "Targetable", "X", "Y", "Z"
+	};
+
+	//The shadows describe what we published to this zone's keys, a new zone starts from nothing
+	if (_spawnShadowZone != _keys.Zone)
+	{
+		_spawnShadows.clear();
+		_spawnShadowZone = _keys.Zone;
+	}
+
+	//Each value is formatted into its own stack buffer and only copied when it differs from the shadow
+	std::array<RelayFormat::Buffer, SpawnFieldCount> buffers;
+	std::array<sw::redis::StringView, SpawnFieldCount> values;
+	const auto format = [&](SpawnField field, const auto& value) {
+		const auto index = static_cast<size_t>(field);
+		values[index] = RelayFormat::Format(buffers[index], value);
+	};
+
+	format(SpawnField::Class, state.Class);
+	format(SpawnField::Type, state.Type);
+	values[static_cast<size_t>(SpawnField::Name)] = state.Name;
+	format(SpawnField::Heading, Fixed{ state.Heading });
+	format(SpawnField::Level, state.Level);
+	format(SpawnField::Mark, state.Mark);
+	format(SpawnField::MasterId, state.MasterId);
+	format(SpawnField::OwnerId, state.OwnerId);
+	format(SpawnField::PetId, state.PetId);
+	format(SpawnField::MaxRange, Fixed{ state.MaxRange });
+	format(SpawnField::MaxRangeTo, Fixed{ state.MaxRangeTo });
+	format(SpawnField::Speed, Fixed{ state.Speed });
+	format(SpawnField::Stunned, state.Stunned);
+	format(SpawnField::Targetable, state.Targetable);
+	format(SpawnField::X, Fixed{ state.X });
+	format(SpawnField::Y, Fixed{ state.Y });
+	format(SpawnField::Z, Fixed{ state.Z });
+
+	const size_t entryStart = _spawnPayload.Size();
+	_spawnPayload.Add(state.SpawnId);
+	_spawnPayload.Add(Fixed{ state.Distance });
+	//The field count is filled in once we know it
+	_spawnPayload.Add(0);
+
+	//Only the fields that changed since the last publish are sent, a spawn with nothing new is still sent with no fields
+	//so the script refreshes its Distance, LastUpdated and expiry. Removal is handled by OnRemoveSpawn so the expiry is
+	//only a safety net. Another client may win the script's distance arbitration and our write is dropped, the script
+	//tells us and the next publish is a full one
+	auto& shadow = _spawnShadows[state.SpawnId];
+	shadow.LastSeen = time;
+	shadow.LastUpdate = time;
+	shadow.Moving = state.Speed != 0;
+	const bool fullPublish = time >= shadow.NextFullPublish;
+	if (fullPublish)
+	{
+		shadow.NextFullPublish = time + _timings.SpawnFullPublishFrequency;
+	}
+	unsigned fieldCount = 0;
+	for (size_t i = 0; i < SpawnFieldCount; ++i)
+	{
+		if (fullPublish || shadow.Fields[i] != values[i])
+		{
+			//assign reuses the shadow's storage, it only allocates when a value outgrows it
+			shadow.Fields[i].assign(values[i].data(), values[i].size());
+			_spawnPayload.Add(fieldNames[i]);
+			_spawnPayload.Add(values[i]);
+			fieldCount++;
+		}
+	}
+	_spawnPayload.Replace(entryStart + 2, fieldCount);
+	_metrics.SpawnFieldsSent.Add(fieldCount);
+
+	//The full publish indexes it again too, in case a query found its hash gone and took it out
+	if (_options.SpatialIndex)
+	{
+		const float dx = state.X - shadow.IndexedX;
+		const float dy = state.Y - shadow.IndexedY;
+		if (!shadow.Indexed || fullPublish || dx * dx + dy * dy > _options.SpatialMoveThreshold * _options.SpatialMoveThreshold)
+		{
+			_gridAdds.Add(SpatialIndex::Score(state.X, state.Y, _options.SpatialCellSize));
+			_gridAdds.Add(state.SpawnId);
+			shadow.Indexed = true;
+			shadow.IndexedX = state.X;
+			shadow.IndexedY = state.Y;
+		}
+	}
+
+	const size_t buffCountIndex = _spawnPayload.Size();
+	_spawnPayload.Add(0);
+	unsigned buffCount = 0;
+	SpawnBuffState buff;
+	const size_t count = _state.SpawnBuffCount(spawn);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!_state.ReadSpawnBuff(spawn, i, buff))
+		{
+			continue;
+		}
+		_spawnPayload.Add(buff.Slot);
+		_spawnPayload.Add(buff.Staleness);
+		_spawnPayload.Add(buff.SpellId);
+		_spawnPayload.Add(buff.Caster);
+		_spawnPayload.Add(buff.Duration);
+		buffCount++;
+	}
+
+	_spawnPayload.Replace(buffCountIndex, buffCount);
+	shadow.Buffs = shadow.Buffs || buffCount > 0;
 }
 
-std::string Relay::ToString(float value, int precision = 2) {
-	char buffer[64]; // Should be large enough for most floats with specified precision
-	snprintf(buffer, sizeof(buffer), "%.*f", precision, value); // NOLINT(cert-err33-c)
-	return std::string(buffer);
+void Relay::UpdateCharacterStats(RelayBatch& batch, long long time)
+{
+	CharacterStats stats;
+	_state.ReadCharacterStats(stats);
+	_statsChanges.Begin();
+	const auto set = [&](const char* field, const auto& value) { SetCharacterField(_statsChanges, field, value); };
+	// Queue Redis commands using the pipeline
+	set("SpawnId", stats.SpawnId);
+	set("MaxHP", stats.MaxHP);
+	set("MaxMana", stats.MaxMana);
+	set("MaxEndurance", stats.MaxEndurance);
+	set("Level", stats.Level);
+	set("PctExp", Fixed{ stats.PctExp, 6 });
+	set("PctAAExp", Fixed{ stats.PctAAExp, 6 });
+	set("Class", stats.Class);
+	set("Zone", _keys.Zone);
+	set("GroupLeader", _keys.LeaderName);
+	FlushCharacterChanges(batch, _statsChanges, time);
 }
 
-std::string Relay::ToString(DWORD value)
+void Relay::FlushCharacterChanges(RelayBatch& batch, ChangeRecord& changes, long long time)
 {
-	char buffer[11]; // Enough to hold all digits of a DWORD
-	snprintf(buffer, sizeof(buffer), "%lu", value); // NOLINT(cert-err33-c)
-	return std::string(buffer);
+	if (_options.ChangeStreams)
+	{
+		changes.Flush(batch, _keys.GroupChanges, _keys.Character, time, _timings.ChangeStreamMaxLength);
+	}
 }
 
-int64_t Relay::GetPctHP(const PlayerClient* pSpawn)
+void Relay::UpdateXTargetData(RelayBatch& batch, const long long time)
 {
-	return pSpawn->HPMax == 0 ? 0 : pSpawn->HPCurrent * 100 / pSpawn->HPMax;
+	XTargetState xTarget;
+	auto& spawns = Spawns();
+	_xTargetIds.clear();
+	_xTargetHPKeys.Clear();
+	_xTargetHPs.Clear();
+	const size_t count = _state.XTargetSlotCount();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (_state.ReadXTarget(i, xTarget))
+		{
+			_xTargetIds.push_back(xTarget.SpawnId);
+			const KeyBuffer currentKey(_keys.XTargetBase, xTarget.SpawnId);
+			_writes.HSet(currentKey, "AggroPercentage", xTarget.AggroPct);
+			_writes.HSet(currentKey, "Type", xTarget.Role);
+			if (const auto index = spawns.Find(xTarget.SpawnId); index < spawns.Size())
+			{
+				//The table's position can be from the start of the sweep
+				spawns.ReadPosition(index);
+				_writes.HSet(currentKey, "HeadingTo", Fixed{ spawns.Bearing(index) });
+			}
+			_writes.HSet(currentKey, "LineOfSight", xTarget.LineOfSight);
+			_writes.Expire(currentKey, _timings.XTargetExpireTime);
+
+			//This updates the spawn, not the XTarget
+			_xTargetHPKeys.Add(KeyBuffer(_keys.SpawnBase, xTarget.SpawnId));
+			_xTargetHPs.Add(xTarget.PctHP);
+		}
+	}
+	//One script call covers every XTarget's HP
+	if (!_xTargetHPKeys.Empty())
+	{
+		batch.BeginCommand("EVALSHA");
+		batch.Arg(_spawnHPScriptSHA);
+		batch.Arg(_xTargetHPKeys.Size());
+		batch.Args(_xTargetHPKeys);
+		batch.Arg(time);
+		batch.Arg(1);
+		batch.Arg(_timings.SpawnExpireTime);
+		batch.Args(_xTargetHPs);
+	}
+}
+
+void Relay::UpdateMetrics(long long time)
+{
+	const auto& key = _keys.Metrics;
+	_metrics.ForEachTimer([&](const char* name, const LatencyHistogram& histogram) {
+		_writes.HSet(key, KeyBuffer(name, "P50"), histogram.Percentile(50));
+		_writes.HSet(key, KeyBuffer(name, "P99"), histogram.Percentile(99));
+		_writes.HSet(key, KeyBuffer(name, "Max"), histogram.Max());
+		_writes.HSet(key, KeyBuffer(name, "Count"), histogram.Count());
+	});
+	_metrics.ForEachCounter([&](const char* name, const Counter& counter) {
+		_writes.HSet(key, name, counter.Value());
+	});
+	_writes.HSet(key, "SpawnSweepBudget", _sweep.Budget);
+	_writes.HSet(key, "LastUpdated", time);
+	_writes.Expire(key, _timings.MetricsExpireTime);
 }
 
-std::string Relay::GetLeaderName()
+void Relay::UpdateGroupData()
 {
-	char nameBuffer[MAX_STRING] = { 0 };
-	std::string leaderName;
-	if (pLocalPC->Group)
+	//If we're grouped
+	if (GroupRoles roles; _state.ReadGroupRoles(roles))
 	{
-		CGroupMember* pLeader = pLocalPC->Group->GetGroupLeader();
-		strcpy_s(nameBuffer, pLeader->pSpawn->Name);
-		CleanupName(nameBuffer, MAX_STRING, false, false);
-		return nameBuffer;
+		const KeyBuffer groupKey(_state.ServerName(), ":", _keys.LeaderName);
+		_writes.HSet(groupKey, "Puller ", roles.Puller);
+		_writes.HSet(groupKey, "Assist", roles.Assist);
+		_writes.HSet(groupKey, "Tank", roles.Tank);
+		_writes.HSet(groupKey, "Looter", roles.Looter);
+		_writes.HSet(groupKey, "Marker", roles.Marker);
+		_writes.Expire(groupKey, _timings.GroupExpireTime);
 	}
+}
 
-	return "Ungrouped";
+void Relay::UpdateGroupProximity()
+{
+	//Like the roles, only the leader publishes it. Every member would work out the same thing
+	if (_keys.LeaderName != _keys.CharacterName)
+	{
+		return;
+	}
+	std::array<SpawnTable::MemberProximity, SpawnTable::MaxGroupMembers> members;
+	const size_t count = Spawns().GroupProximity(_options.ProximityMeleeRange, _options.ProximitySpellRange, members);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto& member = members[i];
+		_writes.HSet(_keys.Proximity, KeyBuffer(member.Name, ":Nearest"), member.Nearest);
+		_writes.HSet(_keys.Proximity, KeyBuffer(member.Name, ":NearestDistance"), Fixed{ member.NearestDistance });
+		_writes.HSet(_keys.Proximity, KeyBuffer(member.Name, ":InMelee"), member.InMelee);
+		_writes.HSet(_keys.Proximity, KeyBuffer(member.Name, ":InSpell"), member.InSpell);
+	}
+	if (count)
+	{
+		_writes.Expire(_keys.Proximity, _timings.GroupExpireTime);
+	}
 }
 
-std::string Relay::GetCharacterKey()
+void Relay::UpdateRecorder(long long time)
 {
-	//Buffer for names
-	char nameBuffer[MAX_STRING] = { 0 };
+	if (!_recorder || _recorderDirectory != _keys.Recorder)
+	{
+		//The old one finishes writing what it has before it goes
+		_recorder = nullptr;
+		RecorderSettings settings;
+		settings.Directory = _keys.Recorder;
+		settings.KeyFrameFrequency = _timings.RecorderKeyFrameFrequency;
+		settings.SegmentSize = _options.RecorderSegmentSize;
+		settings.SegmentLength = _timings.RecorderSegmentLength;
+		_recorder = std::make_unique<StateRecorder>(std::move(settings), _metrics);
+		_recorderDirectory = _keys.Recorder;
+	}
+	ScopedTimer timer(_metrics.Record);
+	auto frame = _recorder->Acquire();
+	frame->Time = time;
 
-	const std::string serverName = GetServerShortName();
+	CharacterState state;
+	_state.ReadCharacterState(state);
+	auto& character = frame->Character;
+	character.CurrentHP = state.CurrentHP;
+	character.CurrentMana = state.CurrentMana;
+	character.CurrentEndurance = state.CurrentEndurance;
+	character.CastingSpellId = state.CastingSpellId;
+	character.CastingTargetId = state.CastingTargetId;
+	character.TargetId = state.TargetId;
+	character.PctAggro = state.PctAggro;
+	character.AutoAttacking = state.AutoAttacking;
+	character.AutoFiring = state.AutoFiring;
+	character.X = state.X;
+	character.Y = state.Y;
+	character.Z = state.Z;
+	character.Heading = state.Heading;
 
-	strcpy_s(nameBuffer, MAX_STRING, pLocalPC->Name);
-	const std::string characterName = CleanupName(nameBuffer, MAX_STRING, false, false);
-	memset(nameBuffer, 0, MAX_STRING);
+	XTargetState xTarget;
+	for (size_t slot = 0, count = _state.XTargetSlotCount(); slot < count; ++slot)
+	{
+		if (_state.ReadXTarget(slot, xTarget))
+		{
+			frame->XTargets.push_back({ xTarget.SpawnId, xTarget.AggroPct, xTarget.PctHP });
+		}
+	}
 
-	return  serverName + ":" + GetLeaderName() + ":characters:" + characterName;
+	//The table already has every distance, only the spawns in range are read
+	auto& spawns = Spawns();
+	const float range = _options.RecorderRange * _options.RecorderRange;
+	SpawnState spawn;
+	for (size_t i = 0; i < spawns.Size(); ++i)
+	{
+		if (!spawns.Handle(i) || spawns.Distance(i) > range)
+		{
+			continue;
+		}
+		spawns.Read(i, spawn);
+		auto& record = frame->Spawns.emplace_back();
+		record.SpawnId = spawn.SpawnId;
+		record.MasterId = spawn.MasterId;
+		record.OwnerId = spawn.OwnerId;
+		record.PetId = spawn.PetId;
+		record.Class = spawn.Class;
+		record.Type = spawn.Type;
+		record.Level = spawn.Level;
+		record.X = spawn.X;
+		record.Y = spawn.Y;
+		record.Z = spawn.Z;
+		record.Heading = spawn.Heading;
+		record.Speed = spawn.Speed;
+		record.Stunned = spawn.Stunned;
+		record.Targetable = spawn.Targetable;
+	}
+	_recorder->Submit(frame);
+}
+
+void Relay::RefreshKeys()
+{
+	const auto zoneName = _state.ZoneName();
+	const auto leaderName = _state.GroupLeaderName();
+	const auto characterName = _state.CharacterName();
+	//Comparing the names is far cheaper than building the keys, and none of it allocates
+	if (_keys.Valid && _keys.Zone == zoneName && _keys.LeaderName == leaderName && _keys.CharacterName == characterName)
+	{
+		return;
+	}
+	const std::string serverName(_state.ServerName());
+	_keys.Valid = true;
+	_keys.Zone = zoneName;
+	_keys.LeaderName = leaderName;
+	_keys.CharacterName = characterName;
+	_keys.Character = serverName + ":" + _keys.LeaderName + ":characters:" + _keys.CharacterName;
+	_keys.SpawnBase = serverName + ":" + _keys.Zone + ":spawns:";
+	_keys.Snapshot = serverName + ":" + _keys.Zone + ":snapshot";
+	_keys.Recorder = (std::filesystem::path(_options.RecorderDirectory) / (serverName + "_" + _keys.CharacterName)).string();
+	_keys.Grid = serverName + ":" + _keys.Zone + ":grid";
+	_keys.Proximity = serverName + ":" + _keys.LeaderName + ":proximity";
+	_keys.XTargetBase = _keys.Character + ":XTargets:";
+	_keys.Metrics = _keys.Character + ":relay";
+	_keys.ZoneChanges = serverName + ":" + _keys.Zone + ":changes";
+	_keys.GroupChanges = serverName + ":" + _keys.LeaderName + ":changes";
+	if (_options.Directives)
+	{
+		_keys.Coordinator.Directives = _keys.Character + ":directives";
+		_keys.Coordinator.GroupDirectives = serverName + ":" + _keys.LeaderName + ":directives";
+	}
+	if (_options.Heartbeats)
+	{
+		_keys.Coordinator.Heartbeat = serverName + ":heartbeat";
+		_keys.Coordinator.Pong = serverName + ":pong";
+		_keys.Coordinator.Agent = _keys.Character;
+	}
+	if (_directives)
+	{
+		_directives->SetChannels(_keys.Coordinator);
+	}
+	//Zoning doesn't change what the mirror follows, only a new group leader does
+	if (_mirror && _keys.Mirror.Stream != _keys.GroupChanges)
+	{
+		_keys.Mirror.Stream = _keys.GroupChanges;
+		_keys.Mirror.CharacterPrefix = serverName + ":" + _keys.LeaderName + ":characters:";
+		_keys.Mirror.Blackboard = serverName + ":" + _keys.LeaderName + ":blackboard";
+		_mirror->SetKeys(_keys.Mirror);
+	}
+	//A new character key starts from nothing, so its first record carries every field
+	_statsChanges.Reset();
+	_stateChanges.Reset();
+	_keys.Publisher = serverName + ":" + _keys.Zone + ":publisher";
+	_keys.Relays = serverName + ":" + _keys.Zone + ":relays";
+	_election.SetLease(_keys.Publisher, _keys.Character);
+	_keys.Buffs.resize(_state.BuffSlotCount(BuffKind::Buff));
+	for (size_t i = 0; i < _keys.Buffs.size(); ++i)
+	{
+		_keys.Buffs[i] = _keys.Character + ":buffs:" + std::to_string(i);
+	}
+	_keys.Songs.resize(_state.BuffSlotCount(BuffKind::Song));
+	for (size_t i = 0; i < _keys.Songs.size(); ++i)
+	{
+		_keys.Songs[i] = _keys.Character + ":songs:" + std::to_string(i);
+	}
+	//The slots under the new keys have never been written
+	_buffShadows.assign(_keys.Buffs.size(), {});
+	_songShadows.assign(_keys.Songs.size(), {});
+	_buffsExpireTime = 0;
 }
 
 // Initialize the reference in the constructor's initialization list
-Relay::Relay(const std::string& connectionString, const RelayTimings& timings)
-	: _timings(timings)
+Relay::Relay(const std::string& connectionString, GameStateProvider& state, const RelayTimings& timings, const RelayOptions& options)
+	: _state(state), _timings(timings), _options(options), _election(timings), _spawns(state)
 {
+	_sweep.Budget = timings.SpawnSweepBudget;
 	_redis = std::make_unique<sw::redis::Redis>(connectionString);
-	_spawnScriptSHA = _redis->script_load(_spawnScript);
-	_spawnHPScriptSHA = _redis->script_load(_spawnHPScript);
-	_spawnBuffScriptSHA = _redis->script_load(_spawnBuffsScript);
+	//Nothing here talks to redis, so a client started while it's down carries on and catches up once it's back.
+	//The worker loads the scripts, these are just their names
+	_spawnBulkScriptSHA = Sha1Hex(RelayScripts::SpawnBulk);
+	_spawnHPScriptSHA = Sha1Hex(RelayScripts::SpawnHP);
+	_zoneCleanupScriptSHA = Sha1Hex(RelayScripts::ZoneCleanup);
+	_gridPruneScriptSHA = Sha1Hex(RelayScripts::GridPrune);
+	_worker = std::make_unique<RelayWorker>(*_redis, _metrics);
+	if (options.Directives || options.Heartbeats)
+	{
+		_directives = std::make_unique<DirectiveListener>(connectionString, _metrics, _worker->PublishedVersion());
+	}
+	if (options.Mirror)
+	{
+		_mirror = std::make_unique<BlackboardMirror>(connectionString);
+	}
+}
+
+bool Relay::PopDirective(Directive& directive)
+{
+	if (!_directives || !_directives->TryPop(directive))
+	{
+		return false;
+	}
+	_metrics.Directives.Add();
+	_metrics.Directive.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - directive.Received).count()));
+	return true;
 }
@@ -1,8 +1,26 @@
 #pragma once
+#include "BlackboardMirror.h"
+#include "ChangeRecord.h"
+#include "DirectiveListener.h"
+#include "GameState.h"
+#include "PublisherElection.h"
+#include "RelayBatch.h"
+#include "RelayMetrics.h"
+#include "RelayScripts.h"
+#include "RelayWorker.h"
+#include "SpatialIndex.h"
+#include "SpawnTable.h"
+#include "StateRecorder.h"
+#include "WriteCoalescer.h"
+#include "ZoneSnapshot.h"
 #include <sw/redis++/redis.h>
 #include <sw/redis++/queued_redis.h>
-#include <mq/Plugin.h>
+#include <array>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 //All frequencies are in milliseconds
@@ -11,14 +29,148 @@ struct RelayTimings
 {
 	unsigned CharacterStatsUpdateFrequency = 6000;
 	unsigned CharacterStateUpdateFrequency = 100;
-	unsigned SpawnsUpdateFrequency = 6000;
+	//Each spawn is updated as often as it matters right now, see Relay::SpawnUpdateFrequency.
+	//Our target and anything on XTarget
+	unsigned SpawnEngagedUpdateFrequency = 100;
+	//Anything within RelayOptions::SpawnNearRange
+	unsigned SpawnNearUpdateFrequency = 1000;
+	//Anything further away that's moving
+	unsigned SpawnMovingUpdateFrequency = 3000;
+	//Anything further away that's standing still
+	unsigned SpawnsUpdateFrequency = 10000;
+	//How often the whole zone is written to the snapshot when RelayOptions::ZoneSnapshot is set
+	unsigned ZoneSnapshotUpdateFrequency = 6000;
+	//How often the publisher takes spawns that have left the zone out of the spatial index, see RelayScripts::GridPrune
+	unsigned SpatialPruneFrequency = 60000;
+	//Microseconds each update may spend reading spawns, a sweep of the zone that runs over picks up where it
+	//left off on the next update instead of stalling a frame. 0 sweeps the whole zone in one update
+	unsigned SpawnSweepBudget = 500;
+	//When set, the budget is adjusted after each sweep to finish a sweep in about this many milliseconds,
+	//between SpawnSweepMinBudget and SpawnSweepMaxBudget
+	unsigned SpawnSweepTargetPeriod = 0;
+	unsigned SpawnSweepMinBudget = 100;
+	unsigned SpawnSweepMaxBudget = 4000;
+	//The sweep that publishes a zone we've just arrived in gets this budget instead, so the zone is there
+	//for the coordinator within a few frames
+	unsigned ZoneArrivalSweepBudget = 2000;
+	//Keys removed per update when cleaning up after the zone we left, see RelayOptions::ZoneCleanup
+	unsigned ZoneCleanupBatchSize = 500;
+	//How often every field of a spawn is sent, even if we don't think it changed
+	//This also refreshes the spawn's expiry so it needs to be shorter than SpawnExpireTime
+	unsigned SpawnFullPublishFrequency = 30000;
 	unsigned XTargetUpdateFrequency = 100;
 	unsigned BuffUpdateFrequency = 1000;
+	//How often the group leader publishes RelayOptions::GroupProximity
+	unsigned GroupProximityUpdateFrequency = 250;
+	//How often a frame is recorded when RelayOptions::Recorder is set, how often one of them is a key frame
+	//the rest are differenced against, and how long a segment of the log is written before the next is started
+	unsigned RecorderFrequency = 100;
+	unsigned RecorderKeyFrameFrequency = 10000;
+	unsigned RecorderSegmentLength = 3600000;
 	unsigned CharacterExpireTime = 60;
 	unsigned CharacterBuffExpireTime = 60;
 	unsigned SpawnExpireTime = 60;
 	unsigned XTargetExpireTime = 60;
 	unsigned GroupExpireTime = 60;
+	//How often the relay's own metrics are published to <character>:relay
+	unsigned MetricsUpdateFrequency = 10000;
+	unsigned MetricsExpireTime = 60;
+	//How long the zone publisher's lease lasts and how often it's renewed, a publisher that stops
+	//renewing is replaced within PublisherLeaseTime plus PublisherLeaseRenewFrequency
+	unsigned PublisherLeaseTime = 3000;
+	unsigned PublisherLeaseRenewFrequency = 1000;
+	//How often each client adds itself to <server>:<zone>:relays, and how long after that it still counts as in the
+	//zone. A client leaving only removes the zone's shared keys if nobody else is there, see RelayOptions::ZoneCleanup
+	unsigned ZonePresenceFrequency = 5000;
+	unsigned ZonePresenceTimeout = 15000;
+	//Roughly how many records each change stream keeps, older ones are trimmed as new ones are added
+	unsigned ChangeStreamMaxLength = 10000;
+};
+
+//Optional ways of publishing, the defaults match what consumers have always read
+struct RelayOptions
+{
+	//Publish each spawn as a hash of strings under <server>:<zone>:spawns:<id>
+	bool SpawnHashes = true;
+	//Publish the whole zone as one binary blob under <server>:<zone>:snapshot, see ZoneSnapshot.h for the format
+	bool ZoneSnapshot = false;
+	//Only one client per zone, the one holding <server>:<zone>:publisher, publishes every spawn
+	bool PublisherElection = true;
+	//How close a spawn has to be for a client that isn't the publisher to publish it anyway, 0 publishes nothing
+	float NonPublisherRange = 200;
+	//Keep <server>:<zone>:grid, a sorted set of the spawns we publish scored by where they are, for
+	//RelayScripts::SpawnsNear. A spawn is only indexed again once it has moved SpatialMoveThreshold, see SpatialIndex.h
+	bool SpatialIndex = false;
+	float SpatialCellSize = 100;
+	float SpatialMoveThreshold = 10;
+	//Spawns within this range are updated every RelayTimings::SpawnNearUpdateFrequency
+	float SpawnNearRange = 200;
+	//Append what changed to <server>:<zone>:changes for spawns and <server>:<leader>:changes for characters,
+	//so consumers can XREAD the changes instead of polling every hash
+	bool ChangeStreams = false;
+	//Listen for commands from the coordinator on <character>:directives and <server>:<leader>:directives
+	bool Directives = false;
+	//Answer the coordinator's heartbeats on <server>:heartbeat with a pong on <server>:pong, see DirectiveListener
+	bool Heartbeats = false;
+	//Keep a local copy of the group's character hashes and <server>:<leader>:blackboard for the ${Relay} TLO,
+	//see BlackboardMirror
+	bool Mirror = false;
+	//When we leave a zone, UNLINK the XTarget keys we wrote there instead of leaving them to expire. The spawn keys,
+	//snapshot and grid are shared, they're only removed when no other relay is in the zone
+	bool ZoneCleanup = true;
+	//The group leader publishes what's around each member to <server>:<leader>:proximity: the nearest hostile
+	//spawn and how many are within ProximityMeleeRange and ProximitySpellRange, as <member>:Nearest and the like
+	bool GroupProximity = false;
+	float ProximityMeleeRange = 25;
+	float ProximitySpellRange = 200;
+	//Record our state, our XTargets and the spawns within RecorderRange to a local log, delta coded and written on
+	//a thread of its own, see StateLog.h for the format and bench/StateLogTool.cpp for reading it back.
+	//Segments go in RecorderDirectory/<server>_<character> and are started again once they reach RecorderSegmentSize bytes
+	bool Recorder = false;
+	float RecorderRange = 200;
+	std::string RecorderDirectory = "MQRelay";
+	size_t RecorderSegmentSize = 64 * 1024 * 1024;
+};
+
+//Fields published for every spawn, in the order they are sent to the spawn script
+enum class SpawnField : uint8_t
+{
+	Class,
+	Type,
+	Name,
+	Heading,
+	Level,
+	Mark,
+	MasterId,
+	OwnerId,
+	PetId,
+	MaxRange,
+	MaxRangeTo,
+	Speed,
+	Stunned,
+	Targetable,
+	X,
+	Y,
+	Z,
+	Count
+};
+constexpr size_t SpawnFieldCount = static_cast<size_t>(SpawnField::Count);
+
+//What we last published for a spawn, so each tick only sends the fields that changed
+struct SpawnShadow
+{
+	std::array<std::string, SpawnFieldCount> Fields;
+	//Whether we've written the spawn's <spawn>:buffs hash, so it can be removed with it
+	bool Buffs = false;
+	long long NextFullPublish = 0;
+	long long LastSeen = 0;
+	//When we last read the spawn and whether it was moving then, for deciding when it's next due
+	long long LastUpdate = 0;
+	bool Moving = false;
+	//Where the spatial index has it
+	bool Indexed = false;
+	float IndexedX = 0;
+	float IndexedY = 0;
 };
 
 class Relay
@@ -26,118 +178,226 @@ class Relay
 public:
 
 	void Update();
-	void LoadSpellData(sw::redis::Pipeline& pipeline, const std::string& key, const eqlib::EQ_Affect& buff) const;
-	explicit Relay(const std::string& connectionString,const RelayTimings& timings);
+	void OnAddSpawn(SpawnHandle spawn);
+	void OnRemoveSpawn(unsigned spawnId);
+	void OnBeginZone();
+	void OnZoned();
+	//Spawn callbacks aren't passed on outside the game, so the sweep can't rely on hearing about removals
+	void OnLeaveGame();
+	[[nodiscard]] RelayMetrics& Metrics() { return _metrics; }
+	//Microseconds each update may currently spend on the spawn sweep
+	[[nodiscard]] unsigned SpawnSweepBudget() const { return _sweep.Budget; }
+	//Game thread. Hands over the next directive from the coordinator, false when there are none waiting.
+	//Call it every pulse, a directive should never wait longer than a frame
+	bool PopDirective(Directive& directive);
+	//The last error the directive listener hit, empty if it hasn't or isn't running
+	[[nodiscard]] std::string DirectiveError() const { return _directives ? _directives->LastError() : std::string(); }
+	//Whether we publish every spawn in the zone or only the ones near us
+	[[nodiscard]] bool IsZonePublisher() const;
+	//Null unless RelayOptions::Mirror is set
+	[[nodiscard]] const BlackboardMirror* Mirror() const { return _mirror.get(); }
+	//The last error the recorder hit, empty if it hasn't or isn't running
+	[[nodiscard]] std::string RecorderError() const { return _recorder ? _recorder->LastError() : std::string(); }
+	Relay(const std::string& connectionString, GameStateProvider& state, const RelayTimings& timings, const RelayOptions& options);
 private:
-	static std::string GetCombatState();
-	static std::string ToString(int value);
-	static std::string ToString(uint8_t value);
-	static std::string ToString(float value, int precision);
-	static std::string ToString(unsigned value);
-	static std::string ToString(DWORD value);
-	static int64_t GetPctHP(const PlayerClient* pSpawn);
-	static void UpdateCharacterState(sw::redis::Pipeline& pipeline);
-	static void UpdateCharacterStats(sw::redis::Pipeline& pipeline);
-	void UpdateGroupData(sw::redis::Pipeline& pipeline) const;
-	void UpdateBuffData(sw::redis::Pipeline& pipeline) const;
-	void UpdateXTargetData(sw::redis::Pipeline& pipeline, long long time) const;
-	void UpdateSpawnData(sw::redis::Pipeline& pipe, long long time) const;
+	void UpdateCharacterState(RelayBatch& batch, long long time);
+	void UpdateCharacterStats(RelayBatch& batch, long long time);
+	//HSets a field of the character hash and notes it for the character's change stream record
+	template <typename T>
+	void SetCharacterField(ChangeRecord& changes, const char* field, const T& value)
+	{
+		RelayFormat::Buffer buffer;
+		const auto formatted = RelayFormat::Format(buffer, value);
+		_writes.HSet(_keys.Character, field, formatted);
+		if (_options.ChangeStreams)
+		{
+			changes.Field(field, formatted);
+		}
+	}
+	void FlushCharacterChanges(RelayBatch& batch, ChangeRecord& changes, long long time);
+	void UpdateGroupData();
+	void UpdateGroupProximity();
+	void UpdateRecorder(long long time);
+	//What we last published for one of our buff slots
+	struct BuffShadow
+	{
+		BuffSignature Signature;
+		bool Published = false;
+	};
+	void UpdateBuffData(long long time);
+	void UpdateBuffSlots(BuffKind kind, const std::vector<std::string>& keys, std::vector<BuffShadow>& shadows, long long time, bool refreshExpiry);
+	void PublishBuff(const sw::redis::StringView& key, const BuffState& buff, long long time);
+	void UpdateXTargetData(RelayBatch& batch, long long time);
+	//Builds the spawn table the first time an update asks for it
+	SpawnTable& Spawns();
+	void UpdateSpawnData(RelayBatch& batch, long long time);
+	void UpdateSpawnLifecycle(RelayBatch& batch, long long time);
+	void FinishSpawnSweep(RelayBatch& batch, long long time);
+	void UpdateZoneCleanup(RelayBatch& batch, long long time);
+	void UpdateZonePresence(RelayBatch& batch, long long time);
+	//Forgets what we think redis holds so the next updates publish everything again
+	void Resync();
+	void UpdateMetrics(long long time);
+	void PublishSpawn(SpawnHandle spawn, const SpawnState& state, long long time);
+	void FlushSpawnPayload(RelayBatch& batch, long long time);
+	void FlushSpatialIndex(RelayBatch& batch);
+	void PruneSpatialIndex(RelayBatch& batch);
+	void AddToZoneSnapshot(const SpawnState& spawn);
+	[[nodiscard]] bool ShouldPublish(bool publisher, float distance) const;
+	[[nodiscard]] unsigned SpawnUpdateFrequency(unsigned spawnId, float distance, bool moving) const;
+	//Whether a spawn we've already published is due again, marks it as still in the zone either way
+	[[nodiscard]] bool IsSpawnDue(unsigned spawnId, float distance, long long time);
+	GameStateProvider& _state;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
 	const RelayTimings& _timings;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
-	static std::string GetLeaderName();
-	static std::string GetCharacterKey();
+	const RelayOptions& _options;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	PublisherElection _election;
+	//Every key we write is built from the server, zone, group leader and character names.
+	//They only change when we zone or the group changes so they're built once and reused until then
+	struct RelayKeys
+	{
+		//What the keys were built for
+		std::string Zone;
+		std::string LeaderName;
+		std::string CharacterName;
+		bool Valid = false;
+
+		//<server>:<leader>:characters:<name>
+		std::string Character;
+		//<server>:<zone>:spawns:, a spawn id is appended for the spawn's key
+		std::string SpawnBase;
+		//<server>:<zone>:snapshot
+		std::string Snapshot;
+		//<server>:<zone>:grid
+		std::string Grid;
+		//<server>:<leader>:proximity
+		std::string Proximity;
+		//RelayOptions::RecorderDirectory/<server>_<character>, not a key but it changes with them
+		std::string Recorder;
+		//<server>:<zone>:publisher
+		std::string Publisher;
+		//<server>:<zone>:relays
+		std::string Relays;
+		//<character>:XTargets:, a spawn id is appended for the XTarget's key
+		std::string XTargetBase;
+		//<character>:relay
+		std::string Metrics;
+		//<server>:<zone>:changes and <server>:<leader>:changes
+		std::string ZoneChanges;
+		std::string GroupChanges;
+		//What the DirectiveListener listens on
+		CoordinatorChannels Coordinator;
+		//What the BlackboardMirror follows
+		MirrorKeys Mirror;
+		std::vector<std::string> Buffs;
+		std::vector<std::string> Songs;
+	};
+	//Rebuilds the keys if the zone, group leader or character changed since they were built
+	void RefreshKeys();
+	RelayKeys _keys;
+	//Declared before _worker, which writes to it until it's stopped
+	RelayMetrics _metrics;
 	std::unique_ptr<sw::redis::Redis> _redis;
+	//Declared after _redis so it's stopped before the connection goes away
+	std::unique_ptr<RelayWorker> _worker;
+	//Only when RelayOptions::Directives or Heartbeats is set, it has a connection of its own
+	std::unique_ptr<DirectiveListener> _directives;
+	//Only when RelayOptions::Mirror is set, it has a connection of its own too
+	std::unique_ptr<BlackboardMirror> _mirror;
+	//Only when RelayOptions::Recorder is set, made again when the character changes so each has its own directory
+	std::unique_ptr<StateRecorder> _recorder;
+	std::string _recorderDirectory;
+	//Counts the batches we've submitted, each one is written to the character hash as StateVersion so a pong
+	//saying which version reached redis tells the coordinator how current the hash it reads is
+	long long _stateVersion = 0;
+	//Hash writes and expiries of this update, added to the batch as one command per key at the end of it
+	WriteCoalescer _writes;
+	//The batch this update is building, only carried over to the next update when the worker was full
+	std::unique_ptr<RelayBatch> _batch;
+	//A carried over batch bigger than this is thrown away instead of growing forever
+	static constexpr size_t MaxBatchCommands = 50000;
+	uint64_t _reportedFailures = 0;
+	long long _nextFailureReport = 0;
 	long long _characterStatsUpdateTime = 0;
 	long long _characterStateUpdateTime = 0;
 	long long _xTargetsUpdateTime = 0;
+	long long _groupProximityUpdateTime = 0;
+	long long _recorderUpdateTime = 0;
 	long long _buffsUpdateTime = 0;
+	//Buff keys only need their expiry pushed back every so often, not every time we look at them
+	long long _buffsExpireTime = 0;
 	long long _spawnsUpdateTime = 0;
-	std::string _spawnScriptSHA;
+	long long _metricsUpdateTime = 0;
+	long long _zoneSnapshotUpdateTime = 0;
+	long long _gridPruneTime = 0;
+	long long _zonePresenceTime = 0;
+	//Engaged spawns, as of the last character state and XTarget updates
+	unsigned _targetId = 0;
+	std::vector<unsigned> _xTargetIds;
+	//Keys and HPs for this update's SpawnHP call
+	ArgBuffer _xTargetHPKeys;
+	ArgBuffer _xTargetHPs;
+	//A pass over the zone's spawns, spread over as many updates as SpawnSweepBudget needs
+	struct SpawnSweep
+	{
+		bool Active = false;
+		//The next slot of the spawn table to read, the table isn't built again until the sweep is done
+		size_t Next = 0;
+		long long Start = 0;
+		//Decided when the sweep starts so every spawn in it is treated the same
+		bool Publisher = false;
+		bool ZoneSnapshot = false;
+		//The first sweep after zoning, it runs on ZoneArrivalSweepBudget and doesn't tune Budget
+		bool Arrival = false;
+		unsigned Budget = 0;
+	};
+	SpawnSweep _sweep;
+	//Set by OnZoned until the arrival sweep starts. It waits for the election, within reason, so a raid
+	//zoning in together doesn't all publish the whole zone
+	bool _arriving = false;
+	long long _arrivalDeadline = 0;
+	//The keys we wrote in the zone we left, removed ZoneCleanupBatchSize at a time.
+	//The first Owned of them are ours alone, the rest are shared with anyone else still in the zone
+	struct ZoneCleanup
+	{
+		std::string Relays;
+		std::string Candidate;
+		ArgBuffer Keys;
+		size_t Owned = 0;
+		size_t Next = 0;
+	};
+	ZoneCleanup _zoneCleanup;
+	//Built when a sweep starts, or every SpawnsUpdateFrequency without one, and refreshed once in every other update
+	//that reads it, see Spawns()
+	SpawnTable _spawns;
+	bool _spawnsBuilt = false;
+	bool _spawnsRefreshed = false;
+	long long _spawnsBuildTime = 0;
+	std::unordered_map<unsigned, SpawnShadow> _spawnShadows;
+	std::string _spawnShadowZone;
+	//Spawns the worker says lost arbitration, kept so the vector is reused
+	std::vector<long long> _lostSpawns;
+	//Spawns added since the last update, they get their full record published on the next update
+	std::vector<unsigned> _addedSpawns;
+	//Keys of spawns removed since the last update, unlinked on the next update
+	ArgBuffer _removedSpawnKeys;
+	//Spawns removed since the last update, only kept for the change stream
+	std::vector<unsigned> _removedSpawnIds;
+	//Score and spawn id pairs to add to the spatial index this update, and spawn ids to take out of it
+	ArgBuffer _gridAdds;
+	ArgBuffer _gridRemovals;
+	//What the character hash last held, one for each update that writes it
+	ChangeRecord _statsChanges;
+	ChangeRecord _stateChanges;
+	//One for each of our buff and song slots, a slot is only read in full and published when its signature changes
+	std::vector<BuffShadow> _buffShadows;
+	std::vector<BuffShadow> _songShadows;
+	//Between OnBeginZone and OnZoned spawns are removed because we're leaving, not because they despawned
+	bool _zoning = false;
+	//Arguments for this update's SpawnBulk call, see RelayScripts::SpawnBulk for the layout
+	ArgBuffer _spawnPayload;
+	ZoneSnapshot::Writer _zoneSnapshot;
+	std::string _spawnBulkScriptSHA;
 	std::string _spawnHPScriptSHA;
-	std::string _spawnBuffScriptSHA;
-	const std::string _spawnBuffsScript = // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
-						R"( 
-						--stored in zone:spawns:123:buffs:1
-						local key           = KEYS[1]
-						local buffStaleness = tonumber(redis.call('HGET', key, 'Staleness')) or math.huge
-						local buffUpdated   = tonumber(redis.call('HGET', key, 'Updated')) or 0
-						local buffSpellId   = tonumber(redis.call('HGET', key, 'SpellId')) or -1
-						local staleness     = tonumber(ARGV[1])
-						local currentTime   = tonumber(ARGV[2])
-						local spellId       = tonumber(ARGV[3])
-						local duration = tonumber(ARGV[5])
-
-						--if the data is one second or more stale
-						--or the spell id is different
-						--or it hasn't been updated in a second
-						if (buffStaleness - staleness > 1000) or buffSpellId ~= spellId or currentTime - buffUpdated > 1000 then
-						    redis.call('HSET', key, "SpellId", spellId,"CasterName", ARGV[4],"Duration", duration,'Staleness', staleness,'Updated', currentTime)
-						end
-						redis.call('EXPIRE', key, math.ceil(duration / 1000)+1)
-					)";
-	const std::string _spawnHPScript = // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
-						R"(
-						local key = KEYS[1]
-
-						--HPUpdateFrom is magic numbers, XTarget = 1, TargetOfTarget = 2, Target = 3
-						local updateHPFrom = tonumber(redis.call('HGET', key, 'HPUpdateFrom')) or 0
-						local lastHPUpdated = tonumber(redis.call('HGET', key, 'LastHPUpdated') or 0)
-						local currentTime = tonumber(ARGV[1])
-						local newHPFrom = tonumber(ARGV[2])
-						local expireTime = tonumber(ARGV[3])
-						local HPValue = tonumber(ARGV[4])
-
-						-- Update the hash if the conditions are met
-						if (newHPFrom > updateHPFrom) or (currentTime - lastHPUpdated) > 500 then
-						    redis.call('HSET',key,"PercentHPs",HPValue)
-						    -- Update the 'Distance' and 'LastUpdated' fields
-						    redis.call('HSET', key, 'HPUpdateFrom', newHPFrom)
-						    redis.call('HSET', key, 'LastHPUpdated', currentTime)
-						end
-						redis.call('EXPIRE', key, expireTime)
-						)";
-	const std::string _spawnScript = // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
-						R"(
-						-- KEYS[1]: Full key of the format "<zoneName>:spawns:<spawnId>"
-					    -- ARGV[1]: Current time (timestamp)
-					    -- ARGV[2]: New distance
-					    -- ARGV[3...]: New data fields in pairs
-
-					    local key = KEYS[1]
-
-					    -- Fetch the current distance and last updated timestamp from the hash
-					    local currentDistance = tonumber(redis.call('HGET', key, 'Distance') or math.huge)
-					    local lastUpdated = tonumber(redis.call('HGET', key, 'LastUpdated') or 0)
-					    local currentTime = tonumber(ARGV[1])
-					    local newDistance = tonumber(ARGV[2])
-					    local expireTime = tonumber(ARGV[3])
-
-					    -- Determine if the incoming data is more recent and closer or within the accurate range
-					    local shouldUpdate = false
-					    if (newDistance <= 200 and currentDistance <= 200) then
-					        --both are within update distance in game
-					        --So if the old one is half a second old we'll update it
-					        if currentTime - lastUpdated > 500 then
-					            shouldUpdate = true
-					        end
-					    elseif newDistance<=200 then
-					        --old one had to have been greater than 200 units away, so we'll update with this data
-					        shouldUpdate = true
-					    elseif math.abs(newDistance - currentDistance)>200 then
-					        --the old distance is a good deal further away, we'll override it
-					        shouldUpdate = true
-					    end
-
-					    -- Update the hash if the conditions are met
-					    if shouldUpdate then
-					        -- Loop through the ARGV table to update the fields, starting from the third argument
-					        for i = 4, #ARGV - 1, 2 do
-					            redis.call('HSET', key, ARGV[i], ARGV[i + 1])
-					        end
-					        -- Update the 'Distance' and 'LastUpdated' fields
-					        redis.call('HSET', key, 'Distance', newDistance)
-					        redis.call('HSET', key, 'LastUpdated', currentTime)
-					    end
-
-					    redis.call('EXPIRE',key,expireTime)
-						)";
+	std::string _zoneCleanupScriptSHA;
+	std::string _gridPruneScriptSHA;
 };
@@ -0,0 +1,126 @@
+#include "RelayBacklog.h"
+#include <charconv>
+
+namespace
+{
+long long ToInteger(const sw::redis::StringView& value)
+{
+	long long result = -1;
+	std::from_chars(value.data(), value.data() + value.size(), result);
+	return result;
+}
+}
+
+RelayBacklog::RelayBacklog(size_t maxBytes)
+	: _maxBytes(maxBytes)
+{
+}
+
+RelayBacklog::KeyState& RelayBacklog::Key(const sw::redis::StringView& key)
+{
+	auto [state, added] = _keys.try_emplace(std::string(key.data(), key.size()));
+	if (added)
+	{
+		_bytes += key.size();
+	}
+	return state->second;
+}
+
+void RelayBacklog::Assign(std::string& target, const sw::redis::StringView& value)
+{
+	_bytes = _bytes - target.size() + value.size();
+	target.assign(value.data(), value.size());
+}
+
+bool RelayBacklog::Fold(const RelayBatch& batch)
+{
+	bool kept = true;
+	for (size_t command = 0; command < batch.CommandCount(); ++command)
+	{
+		const auto [begin, end] = batch.CommandRange(command);
+		const auto name = batch.Argument(begin);
+		const size_t count = end - begin;
+		if (name == "HSET" && count >= 4 && count % 2 == 0)
+		{
+			auto& key = Key(batch.Argument(begin + 1));
+			for (size_t i = begin + 2; i < end; i += 2)
+			{
+				const auto field = batch.Argument(i);
+				auto [entry, added] = key.Fields.try_emplace(std::string(field.data(), field.size()));
+				if (added)
+				{
+					_bytes += field.size();
+				}
+				Assign(entry->second, batch.Argument(i + 1));
+			}
+		}
+		else if (name == "EXPIRE" && count == 3)
+		{
+			Key(batch.Argument(begin + 1)).Expire = ToInteger(batch.Argument(begin + 2));
+		}
+		//SET key value EX seconds, the only form Relay sends
+		else if (name == "SET" && count == 5)
+		{
+			auto& key = Key(batch.Argument(begin + 1));
+			key.HasValue = true;
+			Assign(key.Value, batch.Argument(begin + 2));
+			key.Expire = ToInteger(batch.Argument(begin + 4));
+		}
+		else if (name == "UNLINK")
+		{
+			for (size_t i = begin + 1; i < end; ++i)
+			{
+				auto& key = Key(batch.Argument(i));
+				for (const auto& [field, value] : key.Fields)
+				{
+					_bytes -= field.size() + value.size();
+				}
+				_bytes -= key.Value.size();
+				key = KeyState();
+				key.Unlink = true;
+			}
+		}
+		else
+		{
+			kept = false;
+		}
+	}
+	if (_bytes > _maxBytes)
+	{
+		_keys.clear();
+		_bytes = 0;
+		return false;
+	}
+	return kept;
+}
+
+void RelayBacklog::DrainTo(RelayBatch& batch)
+{
+	for (const auto& [key, state] : _keys)
+	{
+		if (state.Unlink)
+		{
+			batch.Command("UNLINK", key);
+		}
+		if (state.HasValue)
+		{
+			batch.Command("SET", key, state.Value);
+		}
+		if (!state.Fields.empty())
+		{
+			batch.BeginCommand("HSET");
+			batch.Arg(key);
+			for (const auto& [field, value] : state.Fields)
+			{
+				batch.Arg(field);
+				batch.Arg(value);
+			}
+		}
+		if (state.Expire >= 0)
+		{
+			batch.Expire(key, state.Expire);
+		}
+	}
+	_keys.clear();
+	_bytes = 0;
+}
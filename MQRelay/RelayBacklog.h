@@ -0,0 +1,36 @@
+#pragma once
+#include "RelayBatch.h"
+#include <string>
+#include <unordered_map>
+
+//What the RelayWorker holds on to while redis is unreachable.
+//Only the latest value of each key and hash field is kept, so an outage costs memory for the keys it touched
+//rather than for how long it lasted. Worker thread only
+class RelayBacklog
+{
+public:
+	explicit RelayBacklog(size_t maxBytes);
+	//Folds the batch in. Returns false if any of it couldn't be kept, script calls and stream appends only make
+	//sense when they happen, or the backlog outgrew maxBytes and was thrown away
+	bool Fold(const RelayBatch& batch);
+	//Adds plain commands that bring redis up to date to the batch and empties the backlog
+	void DrainTo(RelayBatch& batch);
+	[[nodiscard]] bool Empty() const { return _keys.empty(); }
+	[[nodiscard]] size_t Bytes() const { return _bytes; }
+
+private:
+	struct KeyState
+	{
+		//Set when the key was unlinked, anything written after that is written after the unlink
+		bool Unlink = false;
+		bool HasValue = false;
+		std::string Value;
+		std::unordered_map<std::string, std::string> Fields;
+		long long Expire = -1;
+	};
+	KeyState& Key(const sw::redis::StringView& key);
+	void Assign(std::string& target, const sw::redis::StringView& value);
+	std::unordered_map<std::string, KeyState> _keys;
+	size_t _bytes = 0;
+	size_t _maxBytes;
+};
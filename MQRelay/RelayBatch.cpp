@@ -0,0 +1,87 @@
+#include "RelayBatch.h"
+
+void ArgBuffer::Truncate(size_t count)
+{
+	if (count >= _refs.size())
+	{
+		return;
+	}
+	//Anything Replace appended for a later argument is past this offset too
+	_bytes.resize(_refs[count].Offset);
+	_refs.resize(count);
+}
+
+void ArgBuffer::Clear()
+{
+	_bytes.clear();
+	_refs.clear();
+}
+
+void ArgBuffer::Append(const sw::redis::StringView& value)
+{
+	_refs.push_back({ static_cast<uint32_t>(_bytes.size()), static_cast<uint32_t>(value.size()) });
+	_bytes.append(value.data(), value.size());
+}
+
+void RelayBatch::Unlink(const ArgBuffer& keys)
+{
+	if (keys.Empty())
+	{
+		return;
+	}
+	BeginCommand("UNLINK");
+	Args(keys);
+}
+
+void RelayBatch::BeginCommand(const sw::redis::StringView& name)
+{
+	_commandEnds.push_back(_args.Size());
+	Arg(name);
+}
+
+void RelayBatch::Args(const ArgBuffer& args)
+{
+	for (size_t i = 0; i < args.Size(); ++i)
+	{
+		Arg(args[i]);
+	}
+}
+
+void RelayBatch::WatchReply(std::atomic<long long>& result)
+{
+	_replyWatches.push_back({ _commandEnds.size() - 1, &result });
+}
+
+void RelayBatch::AppendTo(sw::redis::Pipeline& pipeline)
+{
+	for (size_t command = 0; command < _commandEnds.size(); ++command)
+	{
+		AppendCommandTo(pipeline, command);
+	}
+}
+
+void RelayBatch::AppendCommandTo(sw::redis::Pipeline& pipeline, size_t command)
+{
+	//Views of every argument are built once per batch, they stay valid until the batch is changed
+	if (_views.size() != _args.Size())
+	{
+		_views.clear();
+		for (size_t i = 0; i < _args.Size(); ++i)
+		{
+			_views.push_back(_args[i]);
+		}
+	}
+	const auto [begin, end] = CommandRange(command);
+	pipeline.command(_views.begin() + static_cast<ptrdiff_t>(begin), _views.begin() + static_cast<ptrdiff_t>(end));
+}
+
+void RelayBatch::Clear()
+{
+	_args.Clear();
+	_commandEnds.clear();
+	_replyWatches.clear();
+	_collected.clear();
+	_version = 0;
+	_started = {};
+	_views.clear();
+}
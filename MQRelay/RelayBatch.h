@@ -0,0 +1,231 @@
+#pragma once
+#include <sw/redis++/redis.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//A number written with a fixed number of decimals, the way floats are stored in redis
+struct Fixed
+{
+	double Value;
+	int Precision = 2;
+};
+
+//Formats values into a caller supplied buffer with std::to_chars so nothing touches the heap
+namespace RelayFormat
+{
+using Buffer = std::array<char, 48>;
+
+template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+sw::redis::StringView Format(Buffer& buffer, T value)
+{
+	const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+	return { buffer.data(), static_cast<size_t>(result.ptr - buffer.data()) };
+}
+
+//MQ hands back plenty of plain enums, eSpawnType and friends, they're published as their number
+template <typename T, std::enable_if_t<std::is_enum_v<T>, int> = 0>
+sw::redis::StringView Format(Buffer& buffer, T value)
+{
+	return Format(buffer, static_cast<std::underlying_type_t<T>>(value));
+}
+
+inline sw::redis::StringView Format(Buffer&, bool value)
+{
+	return value ? "1" : "0";
+}
+
+inline sw::redis::StringView Format(Buffer& buffer, Fixed value)
+{
+	const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value.Value, std::chars_format::fixed, value.Precision);
+	//Only a value too big for the buffer fails, and nothing we publish gets near that
+	if (result.ec != std::errc())
+	{
+		return "0";
+	}
+	return { buffer.data(), static_cast<size_t>(result.ptr - buffer.data()) };
+}
+
+inline sw::redis::StringView Format(Buffer&, const sw::redis::StringView& value)
+{
+	return value;
+}
+
+//Without this string literals would pick the bool overload
+inline sw::redis::StringView Format(Buffer&, const char* value)
+{
+	return value;
+}
+}
+
+//Builds a key on the stack from any mix of strings and numbers
+class KeyBuffer
+{
+public:
+	template <typename... Parts>
+	explicit KeyBuffer(const Parts&... parts)
+	{
+		(Append(parts), ...);
+	}
+
+	template <typename T>
+	KeyBuffer& Append(const T& part)
+	{
+		RelayFormat::Buffer buffer;
+		const auto value = RelayFormat::Format(buffer, part);
+		const size_t length = std::min(value.size(), Capacity - _length);
+		memcpy(_data + _length, value.data(), length);
+		_length += length;
+		return *this;
+	}
+
+	operator sw::redis::StringView() const { return { _data, _length }; }  // NOLINT(google-explicit-constructor)
+
+private:
+	static constexpr size_t Capacity = 256;
+	char _data[Capacity];
+	size_t _length = 0;
+};
+
+//Arguments packed end to end in one buffer
+//Clearing keeps the memory so a buffer that's been used for a few ticks never allocates again
+class ArgBuffer
+{
+public:
+	template <typename T>
+	void Add(const T& value)
+	{
+		RelayFormat::Buffer buffer;
+		Append(RelayFormat::Format(buffer, value));
+	}
+
+	//Points an existing argument at a new value, used to fill in counts once they're known
+	template <typename T>
+	void Replace(size_t index, const T& value)
+	{
+		RelayFormat::Buffer buffer;
+		const auto formatted = RelayFormat::Format(buffer, value);
+		_refs[index] = { static_cast<uint32_t>(_bytes.size()), static_cast<uint32_t>(formatted.size()) };
+		_bytes.append(formatted.data(), formatted.size());
+	}
+
+	//Drops every argument from count onwards
+	void Truncate(size_t count);
+	void Clear();
+	[[nodiscard]] bool Empty() const { return _refs.empty(); }
+	[[nodiscard]] size_t Size() const { return _refs.size(); }
+	[[nodiscard]] size_t Bytes() const { return _bytes.size(); }
+	sw::redis::StringView operator[](size_t index) const { return { _bytes.data() + _refs[index].Offset, _refs[index].Length }; }
+
+private:
+	void Append(const sw::redis::StringView& value);
+	struct Ref
+	{
+		uint32_t Offset;
+		uint32_t Length;
+	};
+	std::string _bytes;
+	std::vector<Ref> _refs;
+};
+
+//The redis commands produced by one or more Relay updates
+//Built on the game thread and executed as a single pipeline by the RelayWorker
+class RelayBatch
+{
+public:
+	template <typename... Args>
+	void Command(const sw::redis::StringView& name, const Args&... args)
+	{
+		BeginCommand(name);
+		(Arg(args), ...);
+	}
+
+	template <typename T>
+	void HSet(const sw::redis::StringView& key, const sw::redis::StringView& field, const T& value)
+	{
+		Command("HSET", key, field, value);
+	}
+
+	void Expire(const sw::redis::StringView& key, long long seconds)
+	{
+		Command("EXPIRE", key, seconds);
+	}
+
+	void Set(const sw::redis::StringView& key, const sw::redis::StringView& value, long long expireSeconds)
+	{
+		Command("SET", key, value, "EX", expireSeconds);
+	}
+
+	template <typename... Args>
+	void EvalSha(const sw::redis::StringView& sha, const sw::redis::StringView& key, const Args&... args)
+	{
+		Command("EVALSHA", sha, 1, key, args...);
+	}
+
+	void Unlink(const ArgBuffer& keys);
+
+	//For commands built up piece by piece, BeginCommand starts one and everything after it is its arguments
+	void BeginCommand(const sw::redis::StringView& name);
+
+	template <typename T>
+	void Arg(const T& value)
+	{
+		_args.Add(value);
+		++_commandEnds.back();
+	}
+
+	void Args(const ArgBuffer& args);
+
+	//The worker stores the integer reply of the last command added in result once the batch has run
+	void WatchReply(std::atomic<long long>& result);
+	struct ReplyWatch
+	{
+		size_t Command;
+		std::atomic<long long>* Result;
+	};
+	[[nodiscard]] const std::vector<ReplyWatch>& ReplyWatches() const { return _replyWatches; }
+	//The worker hands the integers in the array reply of the last command added back through RelayWorker::TakeCollected
+	void CollectReply() { _collected.push_back(_commandEnds.size() - 1); }
+	[[nodiscard]] const std::vector<size_t>& CollectedReplies() const { return _collected; }
+
+	//The state version this batch brings redis up to, see Relay::PublishedVersion
+	void SetVersion(long long version) { _version = version; }
+	[[nodiscard]] long long Version() const { return _version; }
+	//When the update that started the batch ran, the worker times it from there to redis having it
+	void SetStarted(std::chrono::steady_clock::time_point started) { _started = started; }
+	[[nodiscard]] std::chrono::steady_clock::time_point Started() const { return _started; }
+
+	//Queues every command in this batch onto the pipeline
+	void AppendTo(sw::redis::Pipeline& pipeline);
+	//Queues just one of them, for retrying a command that failed
+	void AppendCommandTo(sw::redis::Pipeline& pipeline, size_t command);
+	//The arguments of a command, the first being its name, as indexes for Argument
+	[[nodiscard]] std::pair<size_t, size_t> CommandRange(size_t command) const
+	{
+		return { command ? _commandEnds[command - 1] : 0, _commandEnds[command] };
+	}
+	[[nodiscard]] sw::redis::StringView Argument(size_t index) const { return _args[index]; }
+	void Clear();
+	[[nodiscard]] bool Empty() const { return _commandEnds.empty(); }
+	[[nodiscard]] size_t CommandCount() const { return _commandEnds.size(); }
+	[[nodiscard]] size_t Bytes() const { return _args.Bytes(); }
+
+private:
+	ArgBuffer _args;
+	//Index one past the last argument of each command
+	std::vector<size_t> _commandEnds;
+	std::vector<ReplyWatch> _replyWatches;
+	std::vector<size_t> _collected;
+	long long _version = 0;
+	std::chrono::steady_clock::time_point _started;
+	//Only used by the worker while it owns the batch
+	std::vector<sw::redis::StringView> _views;
+};
@@ -0,0 +1,138 @@
+#include "RelayMetrics.h"
+#include <algorithm>
+
+void LatencyHistogram::Record(uint64_t micros)
+{
+	_buckets[BucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum.fetch_add(micros, std::memory_order_relaxed);
+	//Only one thread writes so there's no race between the load and the store
+	if (micros > _max.load(std::memory_order_relaxed))
+	{
+		_max.store(micros, std::memory_order_relaxed);
+	}
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const
+{
+	const uint64_t count = Count();
+	if (!count)
+	{
+		return 0;
+	}
+	//The rank of the value we want, 1 based so the 0th percentile is the smallest value
+	const auto rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count) + 0.5);
+	const uint64_t target = rank ? rank : 1;
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < BucketCount; ++bucket)
+	{
+		seen += _buckets[bucket].load(std::memory_order_relaxed);
+		if (seen >= target)
+		{
+			//A bucket's upper bound can be past anything recorded, and the last bucket holds everything too big for the others
+			const auto highest = HighestValueIn(bucket);
+			return highest < Max() && bucket != BucketCount - 1 ? highest : Max();
+		}
+	}
+	return Max();
+}
+
+uint64_t LatencyHistogram::Mean() const
+{
+	const uint64_t count = Count();
+	return count ? _sum.load(std::memory_order_relaxed) / count : 0;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (size_t bucket = 0; bucket < BucketCount; ++bucket)
+	{
+		_buckets[bucket].fetch_add(other._buckets[bucket].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	_count.fetch_add(other.Count(), std::memory_order_relaxed);
+	_sum.fetch_add(other._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	if (other.Max() > Max())
+	{
+		_max.store(other.Max(), std::memory_order_relaxed);
+	}
+}
+
+void LatencyHistogram::MergeSince(const LatencyHistogram& source, LatencyHistogram& previous)
+{
+	uint64_t count = 0;
+	size_t highest = BucketCount;
+	for (size_t bucket = 0; bucket < BucketCount; ++bucket)
+	{
+		//Buckets only ever go up, so the difference is what went in since, even if the writer is mid record
+		const uint32_t now = source._buckets[bucket].load(std::memory_order_relaxed);
+		const uint32_t added = now - previous._buckets[bucket].load(std::memory_order_relaxed);
+		if (!added)
+		{
+			continue;
+		}
+		previous._buckets[bucket].store(now, std::memory_order_relaxed);
+		_buckets[bucket].fetch_add(added, std::memory_order_relaxed);
+		count += added;
+		highest = bucket;
+	}
+	_count.fetch_add(count, std::memory_order_relaxed);
+	previous._count.fetch_add(count, std::memory_order_relaxed);
+	const uint64_t sum = source._sum.load(std::memory_order_relaxed);
+	_sum.fetch_add(sum - previous._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	previous._sum.store(sum, std::memory_order_relaxed);
+	if (highest < BucketCount)
+	{
+		const uint64_t max = std::min(HighestValueIn(highest), source.Max());
+		if (max > Max())
+		{
+			_max.store(max, std::memory_order_relaxed);
+		}
+	}
+}
+
+void LatencyHistogram::Reset()
+{
+	for (auto& bucket : _buckets)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	_count.store(0, std::memory_order_relaxed);
+	_sum.store(0, std::memory_order_relaxed);
+	_max.store(0, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::BucketFor(uint64_t micros)
+{
+	if (micros < LinearBuckets)
+	{
+		return static_cast<size_t>(micros);
+	}
+	//Index of the highest set bit, at least 5 since micros >= 32
+	size_t magnitude = 63;
+	while (!(micros >> magnitude))
+	{
+		--magnitude;
+	}
+	//The four bits under the highest one pick the sub bucket
+	const size_t shift = magnitude - 4;
+	const size_t bucket = LinearBuckets + (magnitude - 5) * SubBuckets + static_cast<size_t>((micros >> shift) - SubBuckets);
+	return bucket < BucketCount ? bucket : BucketCount - 1;
+}
+
+uint64_t LatencyHistogram::HighestValueIn(size_t bucket)
+{
+	if (bucket < LinearBuckets)
+	{
+		return bucket;
+	}
+	const size_t magnitude = (bucket - LinearBuckets) / SubBuckets + 5;
+	const size_t subBucket = (bucket - LinearBuckets) % SubBuckets;
+	const size_t shift = magnitude - 4;
+	return ((SubBuckets + subBucket + 1) << shift) - 1;
+}
+
+void RelayMetrics::Reset()
+{
+	ForEachTimer([](const char*, LatencyHistogram& histogram) { histogram.Reset(); });
+	ForEachCounter([](const char*, Counter& counter) { counter.Reset(); });
+}
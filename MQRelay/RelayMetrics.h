@@ -0,0 +1,176 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//Latency histogram with HDR style log-linear buckets, values are in microseconds.
+//Values under 32 get a bucket each, above that every power of two is split into 16 buckets so any
+//percentile is within about 6% of the real value. Recording is a couple of relaxed atomic ops, each
+//histogram has one writer thread and can be read from any thread
+class LatencyHistogram
+{
+public:
+	void Record(uint64_t micros);
+	//The highest value that falls in the same bucket as the requested percentile, 0-100
+	[[nodiscard]] uint64_t Percentile(double percentile) const;
+	[[nodiscard]] uint64_t Max() const { return _max.load(std::memory_order_relaxed); }
+	[[nodiscard]] uint64_t Count() const { return _count.load(std::memory_order_relaxed); }
+	[[nodiscard]] uint64_t Mean() const;
+	//Adds everything other has recorded, from this histogram's writer thread
+	void Merge(const LatencyHistogram& other);
+	//Adds what source has recorded since previous was last brought up to date by this, and brings it up to date.
+	//Only reads source, so its writer carries on. Max is the top of the highest bucket anything new went in
+	void MergeSince(const LatencyHistogram& source, LatencyHistogram& previous);
+	void Reset();
+
+private:
+	static constexpr size_t LinearBuckets = 32;
+	static constexpr size_t SubBuckets = 16;
+	//Enough powers of two to cover over a day in microseconds
+	static constexpr size_t BucketCount = LinearBuckets + 32 * SubBuckets;
+	static size_t BucketFor(uint64_t micros);
+	static uint64_t HighestValueIn(size_t bucket);
+	std::array<std::atomic<uint32_t>, BucketCount> _buckets{};
+	std::atomic<uint64_t> _count = 0;
+	std::atomic<uint64_t> _sum = 0;
+	std::atomic<uint64_t> _max = 0;
+};
+
+//Monotonic count, one writer thread and read from any thread
+class Counter
+{
+public:
+	void Add(uint64_t amount = 1) { _value.fetch_add(amount, std::memory_order_relaxed); }
+	[[nodiscard]] uint64_t Value() const { return _value.load(std::memory_order_relaxed); }
+	void Reset() { _value.store(0, std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> _value = 0;
+};
+
+//Records how long it was alive into a histogram
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(LatencyHistogram& histogram)
+		: _histogram(histogram), _start(std::chrono::steady_clock::now())
+	{
+	}
+	~ScopedTimer()
+	{
+		_histogram.Record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count());
+	}
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+	[[nodiscard]] std::chrono::steady_clock::time_point Started() const { return _start; }
+
+private:
+	LatencyHistogram& _histogram;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	std::chrono::steady_clock::time_point _start;
+};
+
+//Everything Relay measures about itself. The game thread writes all of it except Exec, Publish, FailedBatches,
+//HeldBatches and Reconnects, which belong to the RelayWorker, DroppedDirectives and the heartbeat metrics,
+//which belong to the DirectiveListener, and RecordedBytes, which belongs to the StateRecorder
+struct RelayMetrics
+{
+	//A whole Relay::Update
+	LatencyHistogram Tick;
+	//Walking the spawn list and formatting spawns into the payload
+	LatencyHistogram Snapshot;
+	//Building the spawn table, or bringing it up to date, in whichever stage reads spawns first
+	LatencyHistogram Spawns;
+	//Building the character, XTarget and buff commands and the SpawnBulk call
+	LatencyHistogram Serialize;
+	//Filling in the frame for the StateRecorder, when it's on
+	LatencyHistogram Record;
+	//Handing the batch to the worker
+	LatencyHistogram Enqueue;
+	//Round trip of a batch's pipeline to redis, measured on the worker
+	LatencyHistogram Exec;
+	//From the update that started a batch to redis having it, including any wait for the worker. Measured on
+	//the worker, batches held while redis was away aren't counted
+	LatencyHistogram Publish;
+	//From a directive arriving on the listener to the game thread running it
+	LatencyHistogram Directive;
+	//From the coordinator sending a heartbeat to us receiving it, and to redis accepting our pong. Neither is a
+	//round trip, both take the coordinator's time from its message and need its clock to agree with ours
+	LatencyHistogram HeartbeatLag;
+	LatencyHistogram HeartbeatReply;
+
+	Counter Ticks;
+	Counter Batches;
+	Counter Commands;
+	Counter Bytes;
+	Counter SpawnsVisited;
+	Counter SpawnSweeps;
+	Counter SpawnFieldsSent;
+	//Spawn writes that lost the script's arbitration to another client, they're published in full again
+	Counter LostSpawnWrites;
+	Counter BuffSlotsSent;
+	Counter CoalescedUpdates;
+	//Hash writes and expiries folded into a command for the same key instead of getting their own
+	Counter CoalescedWrites;
+	Counter DroppedBatches;
+	Counter FailedBatches;
+	//Batches kept in the backlog because redis couldn't be reached, and how often we lost it
+	Counter HeldBatches;
+	Counter Reconnects;
+	Counter Directives;
+	Counter DroppedDirectives;
+	Counter Heartbeats;
+	//Heartbeat ticks that never reached us, going by the gaps in the tick numbers
+	Counter MissedHeartbeats;
+	//Frames handed to the StateRecorder, frames it was too far behind to take, and what it has written
+	Counter RecordedFrames;
+	Counter DroppedFrames;
+	Counter RecordedBytes;
+
+	//Calls visit(name, histogram) for every timer, in the order they happen in a tick
+	template <typename Visitor>
+	void ForEachTimer(Visitor&& visit)
+	{
+		visit("Tick", Tick);
+		visit("Snapshot", Snapshot);
+		visit("Spawns", Spawns);
+		visit("Serialize", Serialize);
+		visit("Record", Record);
+		visit("Enqueue", Enqueue);
+		visit("Exec", Exec);
+		visit("Publish", Publish);
+		visit("Directive", Directive);
+		visit("HeartbeatLag", HeartbeatLag);
+		visit("HeartbeatReply", HeartbeatReply);
+	}
+
+	template <typename Visitor>
+	void ForEachCounter(Visitor&& visit)
+	{
+		visit("Ticks", Ticks);
+		visit("Batches", Batches);
+		visit("Commands", Commands);
+		visit("Bytes", Bytes);
+		visit("SpawnsVisited", SpawnsVisited);
+		visit("SpawnSweeps", SpawnSweeps);
+		visit("SpawnFieldsSent", SpawnFieldsSent);
+		visit("LostSpawnWrites", LostSpawnWrites);
+		visit("BuffSlotsSent", BuffSlotsSent);
+		visit("CoalescedUpdates", CoalescedUpdates);
+		visit("CoalescedWrites", CoalescedWrites);
+		visit("DroppedBatches", DroppedBatches);
+		visit("FailedBatches", FailedBatches);
+		visit("HeldBatches", HeldBatches);
+		visit("Reconnects", Reconnects);
+		visit("Directives", Directives);
+		visit("DroppedDirectives", DroppedDirectives);
+		visit("Heartbeats", Heartbeats);
+		visit("MissedHeartbeats", MissedHeartbeats);
+		visit("RecordedFrames", RecordedFrames);
+		visit("DroppedFrames", DroppedFrames);
+		visit("RecordedBytes", RecordedBytes);
+	}
+
+	//Not synchronised with the writers, a value recorded while resetting may survive it
+	void Reset();
+};
@@ -0,0 +1,409 @@
+#pragma once
+#include <array>
+#include <string>
+
+//Lua scripts loaded into redis by Relay
+//Kept free of MacroQuest so the benchmarks can load the same scripts
+namespace RelayScripts
+{
+//Arbitrates a single cached buff on a spawn, kept for comparison with the bulk script
+inline const std::string SpawnBuffs =
+						R"( 
+						--stored in zone:spawns:123:buffs:1
+						local key           = KEYS[1]
+						local buffStaleness = tonumber(redis.call('HGET', key, 'Staleness')) or math.huge
+						local buffUpdated   = tonumber(redis.call('HGET', key, 'Updated')) or 0
+						local buffSpellId   = tonumber(redis.call('HGET', key, 'SpellId')) or -1
+						local staleness     = tonumber(ARGV[1])
+						local currentTime   = tonumber(ARGV[2])
+						local spellId       = tonumber(ARGV[3])
+						local duration = tonumber(ARGV[5])
+
+						--if the data is one second or more stale
+						--or the spell id is different
+						--or it hasn't been updated in a second
+						if (buffStaleness - staleness > 1000) or buffSpellId ~= spellId or currentTime - buffUpdated > 1000 then
+						    redis.call('HSET', key, "SpellId", spellId,"CasterName", ARGV[4],"Duration", duration,'Staleness', staleness,'Updated', currentTime)
+						end
+						redis.call('EXPIRE', key, math.ceil(duration / 1000)+1)
+					)";
+
+//Updates spawns' HP from whoever has the best view of them
+inline const std::string SpawnHP =
+						R"(
+						-- KEYS: Spawn keys
+						-- ARGV[1]: Current time (timestamp)
+						-- ARGV[2]: Where the HPs came from
+						-- ARGV[3]: Expire time
+						-- ARGV[4...]: HP for each key, in the same order
+						local currentTime = tonumber(ARGV[1])
+						local newHPFrom = tonumber(ARGV[2])
+						local expireTime = tonumber(ARGV[3])
+						for k, key in ipairs(KEYS) do
+						    local HPValue = tonumber(ARGV[3 + k])
+						    --HPUpdateFrom is magic numbers, XTarget = 1, TargetOfTarget = 2, Target = 3
+						    local current = redis.call('HMGET', key, 'HPUpdateFrom', 'LastHPUpdated')
+						    local updateHPFrom = tonumber(current[1]) or 0
+						    local lastHPUpdated = tonumber(current[2]) or 0
+
+						    -- Update the hash if the conditions are met
+						    if (newHPFrom > updateHPFrom) or (currentTime - lastHPUpdated) > 500 then
+						        redis.call('HSET', key, 'PercentHPs', HPValue, 'HPUpdateFrom', newHPFrom, 'LastHPUpdated', currentTime)
+						    end
+						    redis.call('EXPIRE', key, expireTime)
+						end
+						)";
+
+//Arbitrates a single spawn, kept for comparison with the bulk script
+inline const std::string Spawn =
+						R"(
+						-- KEYS[1]: Full key of the format "<zoneName>:spawns:<spawnId>"
+					    -- ARGV[1]: Current time (timestamp)
+					    -- ARGV[2]: New distance
+					    -- ARGV[3]: Expire time
+					    -- ARGV[4...]: Changed data fields in pairs, none when this is just a keep-alive
+
+					    local key = KEYS[1]
+
+					    -- Fetch the current distance and last updated timestamp from the hash
+					    local currentDistance = tonumber(redis.call('HGET', key, 'Distance') or math.huge)
+					    local lastUpdated = tonumber(redis.call('HGET', key, 'LastUpdated') or 0)
+					    local currentTime = tonumber(ARGV[1])
+					    local newDistance = tonumber(ARGV[2])
+					    local expireTime = tonumber(ARGV[3])
+
+					    -- Determine if the incoming data is more recent and closer or within the accurate range
+					    local shouldUpdate = false
+					    if (newDistance <= 200 and currentDistance <= 200) then
+					        --both are within update distance in game
+					        --So if the old one is half a second old we'll update it
+					        if currentTime - lastUpdated > 500 then
+					            shouldUpdate = true
+					        end
+					    elseif newDistance<=200 then
+					        --old one had to have been greater than 200 units away, so we'll update with this data
+					        shouldUpdate = true
+					    elseif math.abs(newDistance - currentDistance)>200 then
+					        --the old distance is a good deal further away, we'll override it
+					        shouldUpdate = true
+					    end
+
+					    -- Update the hash if the conditions are met
+					    if shouldUpdate then
+					        -- Loop through the ARGV table to update the fields, starting from the third argument
+					        for i = 4, #ARGV - 1, 2 do
+					            redis.call('HSET', key, ARGV[i], ARGV[i + 1])
+					        end
+					        -- Update the 'Distance' and 'LastUpdated' fields
+					        redis.call('HSET', key, 'Distance', newDistance)
+					        redis.call('HSET', key, 'LastUpdated', currentTime)
+					    end
+
+					    redis.call('EXPIRE',key,expireTime)
+						)";
+
+//Arbitrates every spawn and cached buff published in a tick in one call
+//Same rules as Spawn and SpawnBuffs, redis just pays for the script call once. It replies with the spawns whose
+//write was turned down, so the caller knows its shadow of them is wrong.
+//A spawn's buffs all go in one hash, "<server>:<zone>:spawns:<id>:buffs", with a field for each slot holding
+//"SpellId,Duration,Expires,Staleness,Updated,CasterName". It expires with the spawn, and slots more than a
+//second past their Expires are removed whenever the spawn's buffs are written again
+inline const std::string SpawnBulk =
+						R"(
+						-- KEYS[1]: Spawn key prefix of the format "<server>:<zone>:spawns:"
+						-- KEYS[2]: Optional change stream, "<server>:<zone>:changes"
+						-- ARGV[1]: Current time (timestamp)
+						-- ARGV[2]: Spawn expire time
+						-- ARGV[3]: Change stream max length
+						-- ARGV[4...]: For each spawn
+						--     spawn id, distance, number of changed field pairs, the field pairs,
+						--     number of cached buffs, then slot, staleness, spell id, caster name and duration for each buff
+						-- Returns the ids of spawns whose fields lost arbitration or whose hash was gone
+
+						local prefix = KEYS[1]
+						local currentTime = tonumber(ARGV[1])
+						local expireTime = tonumber(ARGV[2])
+						local stream = KEYS[2]
+						local streamLength = ARGV[3]
+						local lost = {}
+						local i = 4
+						while i <= #ARGV do
+						    local spawnId = ARGV[i]
+						    local key = prefix .. spawnId
+						    local newDistance = tonumber(ARGV[i + 1])
+						    local fieldCount = tonumber(ARGV[i + 2])
+						    i = i + 3
+
+						    -- A spawn with no changed fields is a keep-alive, it only refreshes Distance, LastUpdated and the expiry
+						    local current = redis.call('HMGET', key, 'Distance', 'LastUpdated')
+						    local currentDistance = tonumber(current[1]) or math.huge
+						    local lastUpdated = tonumber(current[2]) or 0
+
+						    local shouldUpdate = false
+						    if (newDistance <= 200 and currentDistance <= 200) then
+						        --both are within update distance in game
+						        --So if the old one is half a second old we'll update it
+						        if currentTime - lastUpdated > 500 then
+						            shouldUpdate = true
+						        end
+						    elseif newDistance <= 200 then
+						        --old one had to have been greater than 200 units away, so we'll update with this data
+						        shouldUpdate = true
+						    elseif math.abs(newDistance - currentDistance) > 200 then
+						        --the old distance is a good deal further away, we'll override it
+						        shouldUpdate = true
+						    end
+
+						    if not current[1] and fieldCount == 0 then
+						        -- The hash is gone, a keep-alive would leave just Distance in it. The caller publishes it in full instead
+						        lost[#lost + 1] = tonumber(spawnId)
+						    elseif shouldUpdate then
+						        local fields = {}
+						        for j = i, i + fieldCount * 2 - 1 do
+						            fields[#fields + 1] = ARGV[j]
+						        end
+						        fields[#fields + 1] = 'Distance'
+						        fields[#fields + 1] = newDistance
+						        fields[#fields + 1] = 'LastUpdated'
+						        fields[#fields + 1] = currentTime
+						        redis.call('HSET', key, unpack(fields))
+						        -- Only changed fields we actually wrote go on the stream, a write that lost arbitration didn't change anything
+						        if stream and fieldCount > 0 then
+						            fields[#fields + 1] = 'Key'
+						            fields[#fields + 1] = key
+						            fields[#fields + 1] = 'Time'
+						            fields[#fields + 1] = currentTime
+						            redis.call('XADD', stream, 'MAXLEN', '~', streamLength, '*', unpack(fields))
+						        end
+						    elseif fieldCount > 0 then
+						        -- The caller thinks redis has these fields, it sends them again in full next time
+						        lost[#lost + 1] = tonumber(spawnId)
+						    end
+						    redis.call('EXPIRE', key, expireTime)
+						    i = i + fieldCount * 2
+
+						    local buffCount = tonumber(ARGV[i])
+						    i = i + 1
+						    --Expired slots are pruned even when we have no buffs cached for the spawn, or the last debuff to fade would
+						    --stay until the key expires. No buffs cached doesn't mean it has none, another client may have, so nothing else goes
+						    local buffKey = key .. ':buffs'
+						    local current = redis.call('HGETALL', buffKey)
+						    local slots = {}
+						    local expired = {}
+						    for j = 1, #current, 2 do
+						        local spellId, duration, expires, staleness, updated = string.match(current[j + 1], '^(%-?%d+),(%-?%d+),(%-?%d+),(%-?%d+),(%-?%d+),')
+						        --A duration of 0 or less is a buff that doesn't wear off, its expiry is meaningless
+						        if spellId and (tonumber(duration) <= 0 or tonumber(expires) + 1000 >= currentTime) then
+						            slots[current[j]] = { tonumber(spellId), tonumber(staleness), tonumber(updated) }
+						        else
+						            expired[#expired + 1] = current[j]
+						        end
+						    end
+						    if #expired > 0 then
+						        redis.call('HDEL', buffKey, unpack(expired))
+						    end
+						    if buffCount > 0 then
+						        local fields = {}
+						        for _ = 1, buffCount do
+						            local slot = ARGV[i]
+						            local staleness = tonumber(ARGV[i + 1])
+						            local spellId = tonumber(ARGV[i + 2])
+						            local duration = tonumber(ARGV[i + 4])
+						            local old = slots[slot]
+						            --if there's nothing there
+						            --or the data is one second or more stale
+						            --or the spell id is different
+						            --or it hasn't been updated in a second
+						            if not old or (old[2] - staleness > 1000) or old[1] ~= spellId or currentTime - old[3] > 1000 then
+						                fields[#fields + 1] = slot
+						                fields[#fields + 1] = spellId .. ',' .. duration .. ',' .. (currentTime + duration) .. ',' .. staleness .. ',' .. currentTime .. ',' .. ARGV[i + 3]
+						            end
+						            i = i + 5
+						        end
+						        if #fields > 0 then
+						            redis.call('HSET', buffKey, unpack(fields))
+						        end
+						        redis.call('EXPIRE', buffKey, expireTime)
+						    end
+						end
+						return lost
+						)";
+
+//Takes or renews the lease on publishing a zone's spawns, returns 1 if the caller holds it
+//The holder renews it well inside the lease time, anyone else only gets it once the holder stops
+inline const std::string PublisherLease =
+						R"(
+						-- KEYS[1]: <server>:<zone>:publisher
+						-- ARGV[1]: The candidate, its character key
+						-- ARGV[2]: Lease time in milliseconds
+						local holder = redis.call('GET', KEYS[1])
+						if not holder or holder == ARGV[1] then
+						    redis.call('SET', KEYS[1], ARGV[1], 'PX', ARGV[2])
+						    return 1
+						end
+						return 0
+						)";
+
+//Gives up the lease if the caller still holds it, so the next client doesn't wait for it to lapse
+inline const std::string PublisherRelease =
+						R"(
+						if redis.call('GET', KEYS[1]) == ARGV[1] then
+						    return redis.call('DEL', KEYS[1])
+						end
+						return 0
+						)";
+
+//Removes what a client that left a zone wrote there. The keys only it wrote always go, the spawn keys, snapshot and
+//grid every client in the zone shares only go if no other relay is left there, otherwise they're left to expire
+inline const std::string ZoneCleanup =
+						R"(
+						-- KEYS[1]: The relays in the zone, "<server>:<zone>:relays", scored by when each last said it was there
+						-- KEYS[2...]: Keys to remove, the first ARGV[2] of them ours alone and the rest shared
+						-- ARGV[1]: The client that left, its character key
+						-- ARGV[2]: How many of the keys are ours alone
+						-- ARGV[3]: Current time in milliseconds
+						-- ARGV[4]: How long a relay counts as in the zone after it last said so, in milliseconds
+						-- Returns how many keys were removed
+						redis.call('ZREM', KEYS[1], ARGV[1])
+						redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', '(' .. (tonumber(ARGV[3]) - tonumber(ARGV[4])))
+						local last = #KEYS
+						if redis.call('ZCARD', KEYS[1]) > 0 then
+						    last = 1 + tonumber(ARGV[2])
+						end
+						if last < 2 then
+						    return 0
+						end
+						return redis.call('UNLINK', unpack(KEYS, 2, last))
+						)";
+
+//Radius and nearest-N queries over the spatial index, for the coordinator. Relay itself never calls it.
+//Tangent/libs/relay/SpatialIndex.lua carries the same script for Lua, keep the two in step
+inline const std::string SpawnsNear =
+						R"(
+						-- KEYS[1]: Spatial index of the format "<server>:<zone>:grid", see SpatialIndex.h
+						-- ARGV[1]: Spawn key prefix of the format "<server>:<zone>:spawns:"
+						-- ARGV[2], ARGV[3]: X and Y to search around
+						-- ARGV[4]: Radius
+						-- ARGV[5]: How many of the nearest spawns to return, 0 for every spawn in the radius
+						-- ARGV[6]: Cell size the index is built with, RelayOptions::SpatialCellSize
+						-- ARGV[7]: How far a spawn moves before it's indexed again, RelayOptions::SpatialMoveThreshold
+						-- Returns spawn id and distance pairs, nearest first. Distances only go by X and Y
+						-- Read only. It reads each candidate's spawn hash, ARGV[1] .. id, without it being in KEYS. That works on a
+						-- single redis, a cluster would need the grid and the hashes to share a hash tag
+
+						local grid = KEYS[1]
+						local prefix = ARGV[1]
+						local x = tonumber(ARGV[2])
+						local y = tonumber(ARGV[3])
+						local radius = tonumber(ARGV[4])
+						local count = tonumber(ARGV[5])
+						local cellSize = tonumber(ARGV[6])
+						local slack = tonumber(ARGV[7])
+						local offset = 1048576
+						local stride = 2097152
+						local cx = math.floor(x / cellSize)
+						local cy = math.floor(y / cellSize)
+						-- A spawn can be indexed up to slack away from where its hash says it is
+						local maxRing = math.ceil((radius + slack) / cellSize)
+
+						local found = {}
+						local searched = -1
+
+						local function searchCells(row, from, to)
+						    if from > to then
+						        return
+						    end
+						    local base = (row + offset) * stride + offset
+						    local ids = redis.call('ZRANGEBYSCORE', grid, base + from, base + to)
+						    for _, id in ipairs(ids) do
+						        local position = redis.call('HMGET', prefix .. id, 'X', 'Y')
+						        local px = tonumber(position[1])
+						        local py = tonumber(position[2])
+						        -- A spawn whose hash expired is skipped, the publisher takes it out of the index with GridPrune
+						        if px and py then
+						            local dx = px - x
+						            local dy = py - y
+						            local distance = math.sqrt(dx * dx + dy * dy)
+						            if distance <= radius then
+						                found[#found + 1] = { id, distance }
+						            end
+						        end
+						    end
+						end
+
+						-- Searches every cell up to ring cells away that hasn't been searched yet
+						local function search(ring)
+						    ring = math.min(ring, maxRing)
+						    if ring <= searched then
+						        return
+						    end
+						    for row = cy - ring, cy + ring do
+						        if searched >= 0 and row >= cy - searched and row <= cy + searched then
+						            searchCells(row, cx - ring, cx - searched - 1)
+						            searchCells(row, cx + searched + 1, cx + ring)
+						        else
+						            searchCells(row, cx - ring, cx + ring)
+						        end
+						    end
+						    searched = ring
+						end
+
+						local function byDistance(a, b)
+						    return a[2] < b[2]
+						end
+
+						if count <= 0 then
+						    search(maxRing)
+						else
+						    -- Grow the search until it has enough spawns, then widen it to anything that could be nearer than the furthest of them
+						    local ring = 0
+						    search(ring)
+						    while #found < count and searched < maxRing do
+						        ring = math.max(1, ring * 2)
+						        search(ring)
+						    end
+						    if #found >= count then
+						        table.sort(found, byDistance)
+						        search(math.ceil((found[count][2] + slack) / cellSize))
+						    end
+						end
+
+						table.sort(found, byDistance)
+						local result = {}
+						local limit = #found
+						if count > 0 and count < limit then
+						    limit = count
+						end
+						for i = 1, limit do
+						    result[#result + 1] = found[i][1]
+						    result[#result + 1] = string.format('%.2f', found[i][2])
+						end
+						return result
+						)";
+
+//Takes every spawn out of the spatial index that isn't in the zone any more, returns how many it took out.
+//The publisher sends every spawn id it can see, so whatever an expired hash or a client that left behind goes
+inline const std::string GridPrune =
+						R"(
+						-- KEYS[1]: Spatial index of the format "<server>:<zone>:grid", see SpatialIndex.h
+						-- ARGV: Every spawn id in the zone
+						local live = {}
+						for _, id in ipairs(ARGV) do
+						    live[id] = true
+						end
+						local stale = {}
+						for _, id in ipairs(redis.call('ZRANGE', KEYS[1], 0, -1)) do
+						    if not live[id] then
+						        stale[#stale + 1] = id
+						    end
+						end
+						-- unpack has a limit on how many values it can return
+						for i = 1, #stale, 1000 do
+						    redis.call('ZREM', KEYS[1], unpack(stale, i, math.min(i + 999, #stale)))
+						end
+						return #stale
+						)";
+
+//Everything Relay calls with EVALSHA, the RelayWorker loads these whenever redis doesn't have them
+inline const std::array<const std::string*, 6> Loaded = { &SpawnBulk, &SpawnHP, &PublisherLease, &PublisherRelease, &ZoneCleanup, &GridPrune };
+}
@@ -0,0 +1,71 @@
+#include "RelaySettings.h"
+#include <charconv>
+
+namespace
+{
+//The whole of value has to be a number, so a typo isn't half read
+template <typename Number>
+bool Parse(std::string_view value, Number& number)
+{
+	const auto* end = value.data() + value.size();
+	const auto [last, error] = std::from_chars(value.data(), end, number);
+	return error == std::errc() && last == end;
+}
+
+bool ParseSwitch(std::string_view value, bool& on)
+{
+	if (value == "1" || value == "true" || value == "on")
+	{
+		on = true;
+		return true;
+	}
+	if (value == "0" || value == "false" || value == "off")
+	{
+		on = false;
+		return true;
+	}
+	return false;
+}
+}
+
+namespace RelaySettings
+{
+bool Set(std::string_view name, std::string_view value, RelayTimings& timings, RelayOptions& options)
+{
+	for (const auto& timing : Timings)
+	{
+		if (name == timing.Name)
+		{
+			return Parse(value, timings.*timing.Field);
+		}
+	}
+	for (const auto& option : Switches)
+	{
+		if (name == option.Name)
+		{
+			return ParseSwitch(value, options.*option.Field);
+		}
+	}
+	for (const auto& range : Ranges)
+	{
+		if (name == range.Name)
+		{
+			return Parse(value, options.*range.Field);
+		}
+	}
+	if (name == "RecorderDirectory")
+	{
+		if (value.empty())
+		{
+			return false;
+		}
+		options.RecorderDirectory = value;
+		return true;
+	}
+	if (name == "RecorderSegmentSize")
+	{
+		return Parse(value, options.RecorderSegmentSize);
+	}
+	return false;
+}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "Relay.h"
+#include <string_view>
+
+//Every RelayTimings and RelayOptions field by name, so they can be set without a rebuild: from the plugin's INI,
+//where timings go under [Timings] and options under [Options], and from the benchmarks' command lines
+namespace RelaySettings
+{
+struct NamedTiming
+{
+	const char* Name;
+	unsigned RelayTimings::*Field;
+};
+
+struct NamedSwitch
+{
+	const char* Name;
+	bool RelayOptions::*Field;
+};
+
+struct NamedRange
+{
+	const char* Name;
+	float RelayOptions::*Field;
+};
+
+inline constexpr NamedTiming Timings[] = {
+	{ "CharacterStatsUpdateFrequency", &RelayTimings::CharacterStatsUpdateFrequency },
+	{ "CharacterStateUpdateFrequency", &RelayTimings::CharacterStateUpdateFrequency },
+	{ "SpawnEngagedUpdateFrequency", &RelayTimings::SpawnEngagedUpdateFrequency },
+	{ "SpawnNearUpdateFrequency", &RelayTimings::SpawnNearUpdateFrequency },
+	{ "SpawnMovingUpdateFrequency", &RelayTimings::SpawnMovingUpdateFrequency },
+	{ "SpawnsUpdateFrequency", &RelayTimings::SpawnsUpdateFrequency },
+	{ "ZoneSnapshotUpdateFrequency", &RelayTimings::ZoneSnapshotUpdateFrequency },
+	{ "SpatialPruneFrequency", &RelayTimings::SpatialPruneFrequency },
+	{ "SpawnSweepBudget", &RelayTimings::SpawnSweepBudget },
+	{ "SpawnSweepTargetPeriod", &RelayTimings::SpawnSweepTargetPeriod },
+	{ "SpawnSweepMinBudget", &RelayTimings::SpawnSweepMinBudget },
+	{ "SpawnSweepMaxBudget", &RelayTimings::SpawnSweepMaxBudget },
+	{ "ZoneArrivalSweepBudget", &RelayTimings::ZoneArrivalSweepBudget },
+	{ "ZoneCleanupBatchSize", &RelayTimings::ZoneCleanupBatchSize },
+	{ "SpawnFullPublishFrequency", &RelayTimings::SpawnFullPublishFrequency },
+	{ "XTargetUpdateFrequency", &RelayTimings::XTargetUpdateFrequency },
+	{ "BuffUpdateFrequency", &RelayTimings::BuffUpdateFrequency },
+	{ "GroupProximityUpdateFrequency", &RelayTimings::GroupProximityUpdateFrequency },
+	{ "RecorderFrequency", &RelayTimings::RecorderFrequency },
+	{ "RecorderKeyFrameFrequency", &RelayTimings::RecorderKeyFrameFrequency },
+	{ "RecorderSegmentLength", &RelayTimings::RecorderSegmentLength },
+	{ "CharacterExpireTime", &RelayTimings::CharacterExpireTime },
+	{ "CharacterBuffExpireTime", &RelayTimings::CharacterBuffExpireTime },
+	{ "SpawnExpireTime", &RelayTimings::SpawnExpireTime },
+	{ "XTargetExpireTime", &RelayTimings::XTargetExpireTime },
+	{ "GroupExpireTime", &RelayTimings::GroupExpireTime },
+	{ "MetricsUpdateFrequency", &RelayTimings::MetricsUpdateFrequency },
+	{ "MetricsExpireTime", &RelayTimings::MetricsExpireTime },
+	{ "PublisherLeaseTime", &RelayTimings::PublisherLeaseTime },
+	{ "PublisherLeaseRenewFrequency", &RelayTimings::PublisherLeaseRenewFrequency },
+	{ "ZonePresenceFrequency", &RelayTimings::ZonePresenceFrequency },
+	{ "ZonePresenceTimeout", &RelayTimings::ZonePresenceTimeout },
+	{ "ChangeStreamMaxLength", &RelayTimings::ChangeStreamMaxLength },
+};
+
+inline constexpr NamedSwitch Switches[] = {
+	{ "SpawnHashes", &RelayOptions::SpawnHashes },
+	{ "ZoneSnapshot", &RelayOptions::ZoneSnapshot },
+	{ "PublisherElection", &RelayOptions::PublisherElection },
+	{ "SpatialIndex", &RelayOptions::SpatialIndex },
+	{ "ChangeStreams", &RelayOptions::ChangeStreams },
+	{ "Directives", &RelayOptions::Directives },
+	{ "Heartbeats", &RelayOptions::Heartbeats },
+	{ "Mirror", &RelayOptions::Mirror },
+	{ "ZoneCleanup", &RelayOptions::ZoneCleanup },
+	{ "GroupProximity", &RelayOptions::GroupProximity },
+	{ "Recorder", &RelayOptions::Recorder },
+};
+
+inline constexpr NamedRange Ranges[] = {
+	{ "NonPublisherRange", &RelayOptions::NonPublisherRange },
+	{ "SpatialCellSize", &RelayOptions::SpatialCellSize },
+	{ "SpatialMoveThreshold", &RelayOptions::SpatialMoveThreshold },
+	{ "SpawnNearRange", &RelayOptions::SpawnNearRange },
+	{ "ProximityMeleeRange", &RelayOptions::ProximityMeleeRange },
+	{ "ProximitySpellRange", &RelayOptions::ProximitySpellRange },
+	{ "RecorderRange", &RelayOptions::RecorderRange },
+};
+
+//Calls visit(section, name) for every setting Set knows, section is "Timings" or "Options"
+template <typename Visitor>
+void ForEach(Visitor&& visit)
+{
+	for (const auto& timing : Timings)
+	{
+		visit("Timings", timing.Name);
+	}
+	for (const auto& option : Switches)
+	{
+		visit("Options", option.Name);
+	}
+	for (const auto& range : Ranges)
+	{
+		visit("Options", range.Name);
+	}
+	visit("Options", "RecorderDirectory");
+	visit("Options", "RecorderSegmentSize");
+}
+
+//Sets whichever field is called name. Switches take 1, true, on, 0, false or off.
+//False if there's no such setting or value isn't one it can take, nothing is changed then
+bool Set(std::string_view name, std::string_view value, RelayTimings& timings, RelayOptions& options);
+}
@@ -0,0 +1,245 @@
+#include "RelayWorker.h"
+#include "RelayScripts.h"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+RelayWorker::RelayWorker(sw::redis::Redis& redis, RelayMetrics& metrics)
+	: _redis(redis), _metrics(metrics), _thread(&RelayWorker::Run, this)
+{
+}
+
+RelayWorker::~RelayWorker()
+{
+	_running = false;
+	_signal.fetch_add(1, std::memory_order_release);
+	_signal.notify_one();
+	_thread.join();
+}
+
+std::unique_ptr<RelayBatch> RelayWorker::Acquire()
+{
+	std::unique_ptr<RelayBatch> batch;
+	if (!_free.TryPop(batch))
+	{
+		batch = std::make_unique<RelayBatch>();
+	}
+	return batch;
+}
+
+bool RelayWorker::TrySubmit(std::unique_ptr<RelayBatch>& batch)
+{
+	if (!_pending.TryPush(batch))
+	{
+		return false;
+	}
+	_signal.fetch_add(1, std::memory_order_release);
+	_signal.notify_one();
+	return true;
+}
+
+std::string RelayWorker::LastError() const
+{
+	std::lock_guard lock(_errorMutex);
+	return _lastError;
+}
+
+void RelayWorker::LoadScripts()
+{
+	for (const auto* script : RelayScripts::Loaded)
+	{
+		_redis.script_load(*script);
+	}
+}
+
+void RelayWorker::Collect(const redisReply& reply)
+{
+	if (reply.type != REDIS_REPLY_ARRAY)
+	{
+		return;
+	}
+	std::lock_guard lock(_collectedMutex);
+	for (size_t i = 0; i < reply.elements; ++i)
+	{
+		if (reply.element[i]->type == REDIS_REPLY_INTEGER)
+		{
+			_collected.push_back(reply.element[i]->integer);
+		}
+	}
+}
+
+void RelayWorker::TakeCollected(std::vector<long long>& values)
+{
+	std::lock_guard lock(_collectedMutex);
+	values.swap(_collected);
+	_collected.clear();
+}
+
+bool RelayWorker::Execute(RelayBatch& batch)
+{
+	sw::redis::Pipeline pipe = _redis.pipeline(false);
+	batch.AppendTo(pipe);
+	auto replies = pipe.exec();
+
+	//A restarted redis has forgotten our scripts, load them again and run just the calls that failed
+	_retry.clear();
+	for (size_t i = 0; i < replies.size(); ++i)
+	{
+		const auto& reply = replies.get(i);
+		if (reply.type == REDIS_REPLY_ERROR && reply.len >= 8 && memcmp(reply.str, "NOSCRIPT", 8) == 0)
+		{
+			_retry.push_back(i);
+		}
+	}
+	std::optional<sw::redis::QueuedReplies> retried;
+	if (!_retry.empty())
+	{
+		LoadScripts();
+		sw::redis::Pipeline retryPipe = _redis.pipeline(false);
+		for (const auto command : _retry)
+		{
+			batch.AppendCommandTo(retryPipe, command);
+		}
+		retried.emplace(retryPipe.exec());
+	}
+	//Where the reply that counts for a command is, the retry if it had one
+	const auto reply = [&](size_t command) -> redisReply& {
+		const auto retry = std::find(_retry.begin(), _retry.end(), command);
+		return retry == _retry.end() ? replies.get(command) : retried->get(static_cast<size_t>(retry - _retry.begin()));
+	};
+
+	//Redis runs the rest of a pipeline after a command fails, so a failed command only shows up in its own reply
+	bool failed = false;
+	for (size_t i = 0; i < replies.size(); ++i)
+	{
+		const auto& value = reply(i);
+		if (value.type == REDIS_REPLY_ERROR)
+		{
+			if (!failed)
+			{
+				std::lock_guard lock(_errorMutex);
+				_lastError.assign(value.str, value.len);
+			}
+			failed = true;
+		}
+	}
+	if (failed)
+	{
+		_metrics.FailedBatches.Add();
+	}
+	for (const auto& watch : batch.ReplyWatches())
+	{
+		const auto& value = reply(watch.Command);
+		if (value.type == REDIS_REPLY_INTEGER)
+		{
+			watch.Result->store(value.integer, std::memory_order_relaxed);
+		}
+	}
+	for (const auto command : batch.CollectedReplies())
+	{
+		Collect(reply(command));
+	}
+	return !failed;
+}
+
+void RelayWorker::Hold(const RelayBatch& batch)
+{
+	_metrics.HeldBatches.Add();
+	//Resyncing while redis is away would only be held too, it's asked for once we're back
+	if (!_backlog.Fold(batch))
+	{
+		_lostUpdates = true;
+	}
+}
+void RelayWorker::Run()
+{
+	std::unique_ptr<RelayBatch> batch;
+	//Scripts are loaded on the first batch, the same way they are after reconnecting
+	bool connected = false;
+	auto backoff = MinBackoff;
+	auto retryTime = std::chrono::steady_clock::now();
+	//Whatever was submitted before shutdown still gets sent
+	while (_running.load(std::memory_order_relaxed) || _pending.Size())
+	{
+		//Read before looking at the queue, so a batch submitted after the look changes it and the wait returns
+		const auto signal = _signal.load(std::memory_order_acquire);
+		if (!_pending.TryPop(batch))
+		{
+			if (_running.load(std::memory_order_relaxed))
+			{
+				_signal.wait(signal, std::memory_order_acquire);
+			}
+			continue;
+		}
+		if (!connected && std::chrono::steady_clock::now() < retryTime)
+		{
+			//Still backing off, nothing to do but keep the latest of everything
+			Hold(*batch);
+		}
+		else
+		{
+			try
+			{
+				ScopedTimer timer(_metrics.Exec);
+				if (!connected)
+				{
+					LoadScripts();
+					//Everything held while redis was away goes first, this batch is newer
+					if (!_backlog.Empty())
+					{
+						_backlog.DrainTo(_replay);
+						Execute(_replay);
+						_replay.Clear();
+					}
+					connected = true;
+					backoff = MinBackoff;
+					//Once per outage, however many batches couldn't be held
+					if (_lostUpdates)
+					{
+						_lostUpdates = false;
+						_resync = true;
+					}
+				}
+				const bool executed = Execute(*batch);
+				_metrics.Publish.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch->Started()).count()));
+				//A version is only confirmed if everything before it landed
+				if (executed && batch->Version())
+				{
+					_publishedVersion.store(batch->Version(), std::memory_order_relaxed);
+				}
+			}
+			catch (const sw::redis::ReplyError& e)
+			{
+				//Redis is there and refused something, sending it again won't help
+				_metrics.FailedBatches.Add();
+				std::lock_guard lock(_errorMutex);
+				_lastError = e.what();
+			}
+			catch (const sw::redis::Error& e)
+			{
+				_metrics.FailedBatches.Add();
+				{
+					std::lock_guard lock(_errorMutex);
+					_lastError = e.what();
+				}
+				if (connected)
+				{
+					_metrics.Reconnects.Add();
+				}
+				connected = false;
+				retryTime = std::chrono::steady_clock::now() + backoff;
+				backoff = std::min(backoff * 2, MaxBackoff);
+				if (!_replay.Empty())
+				{
+					Hold(_replay);
+					_replay.Clear();
+				}
+				Hold(*batch);
+			}
+		}
+		batch->Clear();
+		//If the free list is full the batch is just released
+		_free.TryPush(batch);
+		batch.reset();
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "RelayBacklog.h"
+#include "RelayBatch.h"
+#include "RelayMetrics.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Executes RelayBatches on its own thread so the game thread never waits on redis
+//Batches are handed over through a lock-free queue and handed back empty for reuse.
+//When redis goes away the worker keeps what it can in a RelayBacklog and retries with backoff, and it loads
+//the scripts again whenever redis has forgotten them
+class RelayWorker
+{
+public:
+	RelayWorker(sw::redis::Redis& redis, RelayMetrics& metrics);
+	~RelayWorker();
+	RelayWorker(const RelayWorker&) = delete;
+	RelayWorker& operator=(const RelayWorker&) = delete;
+
+	//Game thread only. Returns an empty batch, reusing one the worker is done with if it can
+	std::unique_ptr<RelayBatch> Acquire();
+	//Game thread only. Takes ownership of the batch and returns true, or returns false and leaves it with the caller if the worker is behind
+	bool TrySubmit(std::unique_ptr<RelayBatch>& batch);
+
+	[[nodiscard]] std::string LastError() const;
+	//Game thread only. True once when redis is back after an outage in which the worker had to throw away updates
+	//that can't be replayed, the caller should publish everything again from scratch
+	bool TakeResync() { return _resync.exchange(false); }
+	//Game thread only. Swaps in every integer the worker collected from replies since the last call, see RelayBatch::CollectReply
+	void TakeCollected(std::vector<long long>& values);
+	//Version of the last batch that made it to redis, any thread may read it
+	[[nodiscard]] const std::atomic<long long>& PublishedVersion() const { return _publishedVersion; }
+
+private:
+	void Run();
+	void LoadScripts();
+	//Runs the batch, retrying any script call that failed because redis didn't have the script.
+	//False if any command came back with an error, which is counted in FailedBatches and kept as the last error
+	bool Execute(RelayBatch& batch);
+	void Collect(const redisReply& reply);
+	//Keeps what it can of a batch that couldn't be sent
+	void Hold(const RelayBatch& batch);
+	static constexpr auto MinBackoff = std::chrono::milliseconds(100);
+	static constexpr auto MaxBackoff = std::chrono::milliseconds(5000);
+	static constexpr size_t MaxBacklogBytes = 16 * 1024 * 1024;
+	sw::redis::Redis& _redis;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	//The worker records Exec, FailedBatches, HeldBatches and Reconnects, nothing else
+	RelayMetrics& _metrics;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	SpscQueue<std::unique_ptr<RelayBatch>, 4> _pending;
+	SpscQueue<std::unique_ptr<RelayBatch>, 8> _free;
+	std::atomic<bool> _running = true;
+	//Bumped on every submit and on shutdown, the idle worker waits on it instead of polling _pending
+	std::atomic<uint32_t> _signal = 0;
+	std::atomic<long long> _publishedVersion = 0;
+	std::atomic<bool> _resync = false;
+	//Worker thread only
+	RelayBacklog _backlog{ MaxBacklogBytes };
+	RelayBatch _replay;
+	//Something couldn't be kept in the backlog during this outage, _resync is set once redis is back
+	bool _lostUpdates = false;
+	std::vector<size_t> _retry;
+	std::mutex _collectedMutex;
+	std::vector<long long> _collected;
+	mutable std::mutex _errorMutex;
+	std::string _lastError;
+	//Declared last so everything above exists before the thread starts
+	std::thread _thread;
+};
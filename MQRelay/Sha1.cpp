@@ -0,0 +1,102 @@
+#include "Sha1.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+uint32_t Rotate(uint32_t value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+void Compress(std::array<uint32_t, 5>& state, const unsigned char* block)
+{
+	std::array<uint32_t, 80> w{};
+	for (int i = 0; i < 16; ++i)
+	{
+		w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+			   static_cast<uint32_t>(block[i * 4 + 2]) << 8 | static_cast<uint32_t>(block[i * 4 + 3]);
+	}
+	for (int i = 16; i < 80; ++i)
+	{
+		w[i] = Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+	auto [a, b, c, d, e] = state;
+	for (int i = 0; i < 80; ++i)
+	{
+		uint32_t f;
+		uint32_t k;
+		if (i < 20)
+		{
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		}
+		else if (i < 40)
+		{
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		}
+		else if (i < 60)
+		{
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		}
+		else
+		{
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+		const uint32_t temp = Rotate(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = Rotate(b, 30);
+		b = a;
+		a = temp;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+}
+
+std::string Sha1Hex(std::string_view data)
+{
+	std::array<uint32_t, 5> state = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+	size_t offset = 0;
+	for (; offset + 64 <= data.size(); offset += 64)
+	{
+		Compress(state, bytes + offset);
+	}
+
+	//The tail, a single 1 bit, zeros and the length in bits fill out the last one or two blocks
+	std::array<unsigned char, 128> tail{};
+	const size_t remaining = data.size() - offset;
+	memcpy(tail.data(), bytes + offset, remaining);
+	tail[remaining] = 0x80;
+	const size_t tailSize = remaining < 56 ? 64 : 128;
+	const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+	for (int i = 0; i < 8; ++i)
+	{
+		tail[tailSize - 1 - i] = static_cast<unsigned char>(bits >> (i * 8));
+	}
+	for (size_t block = 0; block < tailSize; block += 64)
+	{
+		Compress(state, tail.data() + block);
+	}
+
+	static constexpr char digits[] = "0123456789abcdef";
+	std::string hex;
+	hex.reserve(40);
+	for (const auto word : state)
+	{
+		for (int shift = 28; shift >= 0; shift -= 4)
+		{
+			hex.push_back(digits[(word >> shift) & 0xF]);
+		}
+	}
+	return hex;
+}
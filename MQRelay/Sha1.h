@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+//Lowercase hex SHA-1 of data, which is how redis names a script for EVALSHA.
+//Working it out ourselves means nothing has to ask redis before the first update
+std::string Sha1Hex(std::string_view data);
@@ -0,0 +1,24 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+//Where spawns are kept in <server>:<zone>:grid, a sorted set of spawn ids scored by the grid cell they're in.
+//Cells are square and a score is the cell's row times RowStride plus its column, both offset so they're never
+//negative, which makes every row of cells one contiguous range of scores.
+//RelayScripts::SpawnsNear answers radius and nearest-N queries from it, Tangent/libs/relay/SpatialIndex.lua
+//does the same for Lua
+namespace SpatialIndex
+{
+constexpr int64_t CellOffset = 1 << 20;
+constexpr int64_t RowStride = 1 << 21;
+
+inline int64_t Cell(float coordinate, float cellSize)
+{
+	return static_cast<int64_t>(std::floor(coordinate / cellSize));
+}
+
+inline int64_t Score(float x, float y, float cellSize)
+{
+	return (Cell(y, cellSize) + CellOffset) * RowStride + Cell(x, cellSize) + CellOffset;
+}
+}
@@ -0,0 +1,189 @@
+#include "SpawnGeometry.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SPAWN_GEOMETRY_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPAWN_GEOMETRY_SSE2
+#endif
+
+namespace
+{
+constexpr float HalfPi = 1.57079632679f;
+constexpr float Pi = 3.14159265359f;
+constexpr float Degrees = 57.2957795131f;
+
+//Each instruction set wraps the handful of operations the kernels need, so the kernels are written once.
+//Scalar is also what finishes off the points left over after the last full vector
+struct Scalar
+{
+	using Value = float;
+	using Mask = bool;
+	static constexpr size_t Width = 1;
+	static Value Load(const float* source) { return *source; }
+	static void Store(float* destination, Value value) { *destination = value; }
+	static Value Set(float value) { return value; }
+	static Value Add(Value a, Value b) { return a + b; }
+	static Value Sub(Value a, Value b) { return a - b; }
+	static Value Mul(Value a, Value b) { return a * b; }
+	static Value Div(Value a, Value b) { return a / b; }
+	static Value Min(Value a, Value b) { return std::min(a, b); }
+	static Value Max(Value a, Value b) { return std::max(a, b); }
+	static Value Abs(Value a) { return a < 0 ? -a : a; }
+	static Value Negate(Value a) { return -a; }
+	static Mask Less(Value a, Value b) { return a < b; }
+	static Mask LessEqual(Value a, Value b) { return a <= b; }
+	static Value Select(Mask mask, Value a, Value b) { return mask ? a : b; }
+	static int Bits(Mask mask) { return mask ? 1 : 0; }
+};
+
+#if defined(SPAWN_GEOMETRY_AVX2)
+struct Vector
+{
+	using Value = __m256;
+	using Mask = __m256;
+	static constexpr size_t Width = 8;
+	static Value Load(const float* source) { return _mm256_loadu_ps(source); }
+	static void Store(float* destination, Value value) { _mm256_storeu_ps(destination, value); }
+	static Value Set(float value) { return _mm256_set1_ps(value); }
+	static Value Add(Value a, Value b) { return _mm256_add_ps(a, b); }
+	static Value Sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+	static Value Mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+	static Value Div(Value a, Value b) { return _mm256_div_ps(a, b); }
+	static Value Min(Value a, Value b) { return _mm256_min_ps(a, b); }
+	static Value Max(Value a, Value b) { return _mm256_max_ps(a, b); }
+	static Value Abs(Value a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	static Value Negate(Value a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+	static Mask Less(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask LessEqual(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Value Select(Mask mask, Value a, Value b) { return _mm256_blendv_ps(b, a, mask); }
+	static int Bits(Mask mask) { return _mm256_movemask_ps(mask); }
+};
+#elif defined(SPAWN_GEOMETRY_SSE2)
+struct Vector
+{
+	using Value = __m128;
+	using Mask = __m128;
+	static constexpr size_t Width = 4;
+	static Value Load(const float* source) { return _mm_loadu_ps(source); }
+	static void Store(float* destination, Value value) { _mm_storeu_ps(destination, value); }
+	static Value Set(float value) { return _mm_set1_ps(value); }
+	static Value Add(Value a, Value b) { return _mm_add_ps(a, b); }
+	static Value Sub(Value a, Value b) { return _mm_sub_ps(a, b); }
+	static Value Mul(Value a, Value b) { return _mm_mul_ps(a, b); }
+	static Value Div(Value a, Value b) { return _mm_div_ps(a, b); }
+	static Value Min(Value a, Value b) { return _mm_min_ps(a, b); }
+	static Value Max(Value a, Value b) { return _mm_max_ps(a, b); }
+	static Value Abs(Value a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	static Value Negate(Value a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+	static Mask Less(Value a, Value b) { return _mm_cmplt_ps(a, b); }
+	static Mask LessEqual(Value a, Value b) { return _mm_cmple_ps(a, b); }
+	static Value Select(Mask mask, Value a, Value b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static int Bits(Mask mask) { return _mm_movemask_ps(mask); }
+};
+#else
+using Vector = Scalar;
+#endif
+
+template <typename L>
+size_t DistanceKernel(const float* xs, const float* ys, size_t begin, size_t count, float x, float y, float* distances)
+{
+	const auto originX = L::Set(x);
+	const auto originY = L::Set(y);
+	for (; begin + L::Width <= count; begin += L::Width)
+	{
+		const auto dx = L::Sub(L::Load(xs + begin), originX);
+		const auto dy = L::Sub(L::Load(ys + begin), originY);
+		L::Store(distances + begin, L::Add(L::Mul(dx, dx), L::Mul(dy, dy)));
+	}
+	return begin;
+}
+
+template <typename L>
+size_t BearingKernel(const float* xs, const float* ys, size_t begin, size_t count, float x, float y, float* bearings)
+{
+	const auto originX = L::Set(x);
+	const auto originY = L::Set(y);
+	const auto zero = L::Set(0);
+	const auto tiny = L::Set(1e-20f);
+	for (; begin + L::Width <= count; begin += L::Width)
+	{
+		//${Spawn.HeadingTo} is atan2(our Y - its Y, its X - our X) in degrees, turned a quarter and kept in [0, 360)
+		const auto atanX = L::Sub(L::Load(xs + begin), originX);
+		const auto atanY = L::Sub(originY, L::Load(ys + begin));
+		const auto absX = L::Abs(atanX);
+		const auto absY = L::Abs(atanY);
+		//atan of the smaller over the larger is in [0, 1], where an odd polynomial is good to about 1e-6 radians
+		const auto ratio = L::Div(L::Min(absX, absY), L::Max(L::Max(absX, absY), tiny));
+		const auto square = L::Mul(ratio, ratio);
+		auto angle = L::Add(L::Mul(L::Set(-0.01172120f), square), L::Set(0.05265332f));
+		angle = L::Add(L::Mul(angle, square), L::Set(-0.11643287f));
+		angle = L::Add(L::Mul(angle, square), L::Set(0.19354346f));
+		angle = L::Add(L::Mul(angle, square), L::Set(-0.33262347f));
+		angle = L::Add(L::Mul(angle, square), L::Set(0.99997726f));
+		angle = L::Mul(angle, ratio);
+		//Then back out to the octant and quadrant the point is really in
+		angle = L::Select(L::Less(absX, absY), L::Sub(L::Set(HalfPi), angle), angle);
+		angle = L::Select(L::Less(atanX, zero), L::Sub(L::Set(Pi), angle), angle);
+		angle = L::Select(L::Less(atanY, zero), L::Negate(angle), angle);
+		auto degrees = L::Add(L::Mul(angle, L::Set(Degrees)), L::Set(90));
+		degrees = L::Select(L::Less(degrees, zero), L::Add(degrees, L::Set(360)), degrees);
+		L::Store(bearings + begin, degrees);
+	}
+	return begin;
+}
+
+template <typename L>
+size_t RangeKernel(const float* distances, size_t begin, size_t count, float range, uint8_t bit, uint8_t* masks)
+{
+	const auto limit = L::Set(range);
+	for (; begin + L::Width <= count; begin += L::Width)
+	{
+		//Most spawns are out of range of most of the group, so this rarely writes anything
+		for (int within = L::Bits(L::LessEqual(L::Load(distances + begin), limit)); within; within &= within - 1)
+		{
+			int lane = 0;
+			while (!(within & (1 << lane)))
+			{
+				++lane;
+			}
+			masks[begin + lane] |= bit;
+		}
+	}
+	return begin;
+}
+}
+
+namespace SpawnGeometry
+{
+void DistancesSquared(const float* xs, const float* ys, size_t count, float x, float y, float* distances)
+{
+	const size_t done = DistanceKernel<Vector>(xs, ys, 0, count, x, y, distances);
+	DistanceKernel<Scalar>(xs, ys, done, count, x, y, distances);
+}
+
+void Bearings(const float* xs, const float* ys, size_t count, float x, float y, float* bearings)
+{
+	const size_t done = BearingKernel<Vector>(xs, ys, 0, count, x, y, bearings);
+	BearingKernel<Scalar>(xs, ys, done, count, x, y, bearings);
+}
+
+void MarkWithin(const float* distances, size_t count, float range, uint8_t bit, uint8_t* masks)
+{
+	const size_t done = RangeKernel<Vector>(distances, 0, count, range, bit, masks);
+	RangeKernel<Scalar>(distances, done, count, range, bit, masks);
+}
+
+const char* InstructionSet()
+{
+#if defined(SPAWN_GEOMETRY_AVX2)
+	return "AVX2";
+#elif defined(SPAWN_GEOMETRY_SSE2)
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
+}
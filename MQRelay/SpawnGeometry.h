@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//Distances, bearings and range checks from one point to a column of spawn positions, for SpawnTable.
+//Built for AVX2 when the compiler targets it (/arch:AVX2), otherwise SSE2, which every x64 build has, and plain
+//C++ anywhere else. All of them give the same answers, bench/GeometryBench.cpp compares them against the
+//straightforward scalar code
+namespace SpawnGeometry
+{
+//Squared distances in the plane from (x, y), the same as GetDistanceSquared
+void DistancesSquared(const float* xs, const float* ys, size_t count, float x, float y, float* distances);
+//Degrees from (x, y) to each point, measured the way ${Spawn.HeadingTo} is. Within a hundredth of a degree
+void Bearings(const float* xs, const float* ys, size_t count, float x, float y, float* bearings);
+//ORs bit into masks wherever a squared distance is within range, range is squared too
+void MarkWithin(const float* distances, size_t count, float range, uint8_t bit, uint8_t* masks);
+//"AVX2", "SSE2" or "Scalar"
+const char* InstructionSet();
+}
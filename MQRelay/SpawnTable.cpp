@@ -0,0 +1,310 @@
+#include "SpawnTable.h"
+#include "SpawnGeometry.h"
+#include <cmath>
+#include <functional>
+#include <utility>
+
+namespace
+{
+size_t HashId(unsigned spawnId)
+{
+	//Ids are mostly sequential, spread them over the table
+	return static_cast<size_t>(spawnId) * 0x9E3779B1U;
+}
+
+size_t TableSize(size_t count)
+{
+	size_t size = 64;
+	while (size < count * 2)
+	{
+		size *= 2;
+	}
+	return size;
+}
+}
+
+void SpawnTable::Build()
+{
+	std::swap(_current, _previous);
+	_current.Clear();
+	//The walk below finds them anyway
+	_added.clear();
+	for (auto spawn = _state.FirstSpawn(); spawn; spawn = _state.NextSpawn(spawn))
+	{
+		Append(spawn);
+		if (const size_t previous = _previous.Find(_current.Ids.back()); previous < _previous.Ids.size())
+		{
+			_current.RangeSignatures.back() = _previous.RangeSignatures[previous];
+			_current.MaxRanges.back() = _previous.MaxRanges[previous];
+			_current.MaxRangesTo.back() = _previous.MaxRangesTo[previous];
+			_current.RangesRead.back() = _previous.RangesRead[previous];
+		}
+	}
+	_current.IndexIds();
+	_namesIndexed = false;
+
+	_memberCount = _state.ReadGroupPositions(_members.data(), _members.size());
+	const float x = _memberCount ? _members[0].X : 0;
+	const float y = _memberCount ? _members[0].Y : 0;
+	_current.Distances.resize(Size());
+	_current.Bearings.resize(Size());
+	SpawnGeometry::DistancesSquared(_current.Xs.data(), _current.Ys.data(), Size(), x, y, _current.Distances.data());
+	SpawnGeometry::Bearings(_current.Xs.data(), _current.Ys.data(), Size(), x, y, _current.Bearings.data());
+}
+
+void SpawnTable::Refresh()
+{
+	_memberCount = _state.ReadGroupPositions(_members.data(), _members.size());
+	if (_added.empty())
+	{
+		return;
+	}
+	//Growing the id table means indexing everything again, otherwise only the new spawns go in
+	const bool reindex = (Size() + _added.size()) * 2 > _current.IdTable.size();
+	for (const auto spawn : _added)
+	{
+		Append(spawn);
+		_current.Distances.push_back(0);
+		_current.Bearings.push_back(0);
+		Measure(Size() - 1);
+		if (!reindex)
+		{
+			_current.IndexId(Size() - 1);
+		}
+	}
+	if (reindex)
+	{
+		_current.IndexIds();
+	}
+	_added.clear();
+	_namesIndexed = false;
+}
+
+void SpawnTable::Add(SpawnHandle spawn)
+{
+	_added.push_back(spawn);
+}
+
+void SpawnTable::Remove(unsigned spawnId)
+{
+	if (const size_t index = Find(spawnId); index < Size())
+	{
+		//The slot stays so nothing after it moves, Find skips it and the id is free for a new spawn
+		_current.Handles[index] = 0;
+		_current.Ids[index] = 0;
+		_current.Hostile[index] = 0;
+		_namesIndexed = false;
+	}
+	std::erase_if(_added, [&](SpawnHandle spawn) { return _state.ReadSpawnId(spawn) == spawnId; });
+}
+
+void SpawnTable::Clear()
+{
+	_added.clear();
+	_current.Clear();
+	_current.IndexIds();
+	_previous.Clear();
+	_previous.IndexIds();
+	_namesIndexed = false;
+}
+
+void SpawnTable::ReadPosition(size_t index)
+{
+	SpawnPosition position;
+	_state.ReadSpawnPosition(_current.Handles[index], position);
+	_current.Xs[index] = position.X;
+	_current.Ys[index] = position.Y;
+	_current.Hostile[index] = position.Hostile ? 1 : 0;
+	Measure(index);
+}
+
+void SpawnTable::Read(size_t index, SpawnState& state)
+{
+	const auto spawn = _current.Handles[index];
+	_state.ReadSpawn(spawn, state);
+	_current.Xs[index] = state.X;
+	_current.Ys[index] = state.Y;
+	Measure(index);
+	if (const auto signature = _state.ReadMeleeRangeSignature(spawn); !_current.RangesRead[index] || _current.RangeSignatures[index] != signature)
+	{
+		_state.ReadMeleeRanges(spawn, _current.MaxRanges[index], _current.MaxRangesTo[index]);
+		_current.RangeSignatures[index] = signature;
+		_current.RangesRead[index] = 1;
+	}
+	state.Distance = _current.Distances[index];
+	state.MaxRange = _current.MaxRanges[index];
+	state.MaxRangeTo = _current.MaxRangesTo[index];
+	state.OwnerId = state.OwnerName.empty() ? 0 : FindByName(state.OwnerName);
+}
+
+size_t SpawnTable::GroupProximity(float meleeRange, float spellRange, std::array<MemberProximity, MaxGroupMembers>& members)
+{
+	const size_t count = Size();
+	_memberDistances.resize(count);
+	_meleeMasks.assign(count, 0);
+	_spellMasks.assign(count, 0);
+	for (size_t m = 0; m < _memberCount; ++m)
+	{
+		auto& member = members[m];
+		member = { _members[m].Name };
+		//Our own distances are already in the table
+		const float* distances = _current.Distances.data();
+		if (m > 0)
+		{
+			SpawnGeometry::DistancesSquared(_current.Xs.data(), _current.Ys.data(), count, _members[m].X, _members[m].Y, _memberDistances.data());
+			distances = _memberDistances.data();
+		}
+		const auto bit = static_cast<uint8_t>(1 << m);
+		SpawnGeometry::MarkWithin(distances, count, meleeRange * meleeRange, bit, _meleeMasks.data());
+		SpawnGeometry::MarkWithin(distances, count, spellRange * spellRange, bit, _spellMasks.data());
+		float nearest = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (_current.Hostile[i] && (!member.Nearest || distances[i] < nearest))
+			{
+				member.Nearest = _current.Ids[i];
+				nearest = distances[i];
+			}
+		}
+		member.NearestDistance = std::sqrt(nearest);
+	}
+	//Then each spawn's masks say which members it counts for
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!_current.Hostile[i] || !(_meleeMasks[i] | _spellMasks[i]))
+		{
+			continue;
+		}
+		for (size_t m = 0; m < _memberCount; ++m)
+		{
+			members[m].InMelee += (_meleeMasks[i] >> m) & 1;
+			members[m].InSpell += (_spellMasks[i] >> m) & 1;
+		}
+	}
+	return _memberCount;
+}
+
+void SpawnTable::Append(SpawnHandle spawn)
+{
+	SpawnPosition position;
+	_state.ReadSpawnPosition(spawn, position);
+	_current.Handles.push_back(spawn);
+	_current.Ids.push_back(_state.ReadSpawnId(spawn));
+	_current.Xs.push_back(position.X);
+	_current.Ys.push_back(position.Y);
+	_current.Hostile.push_back(position.Hostile ? 1 : 0);
+	_current.RangeSignatures.push_back(0);
+	_current.MaxRanges.push_back(0);
+	_current.MaxRangesTo.push_back(0);
+	_current.RangesRead.push_back(0);
+}
+
+void SpawnTable::Measure(size_t index)
+{
+	const float x = _memberCount ? _members[0].X : 0;
+	const float y = _memberCount ? _members[0].Y : 0;
+	SpawnGeometry::DistancesSquared(&_current.Xs[index], &_current.Ys[index], 1, x, y, &_current.Distances[index]);
+	SpawnGeometry::Bearings(&_current.Xs[index], &_current.Ys[index], 1, x, y, &_current.Bearings[index]);
+}
+
+unsigned SpawnTable::FindByName(std::string_view name)
+{
+	if (!_namesIndexed)
+	{
+		IndexNames();
+	}
+	const size_t mask = _nameTable.size() - 1;
+	for (size_t slot = std::hash<std::string_view>()(name) & mask;; slot = (slot + 1) & mask)
+	{
+		const auto entry = _nameTable[slot];
+		if (entry == 0)
+		{
+			return 0;
+		}
+		if (_names[entry - 1] == name)
+		{
+			return _current.Ids[entry - 1];
+		}
+	}
+}
+
+void SpawnTable::IndexNames()
+{
+	_names.clear();
+	_nameTable.assign(TableSize(Size()), 0);
+	const size_t mask = _nameTable.size() - 1;
+	for (size_t i = 0; i < Size(); ++i)
+	{
+		//A removed spawn's slot keeps an empty name so the indexes still line up
+		if (!_current.Handles[i])
+		{
+			_names.emplace_back();
+			continue;
+		}
+		const auto name = _state.ReadSpawnName(_current.Handles[i]);
+		_names.push_back(name);
+		auto slot = std::hash<std::string_view>()(name) & mask;
+		while (_nameTable[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		_nameTable[slot] = static_cast<uint32_t>(i + 1);
+	}
+	_namesIndexed = true;
+}
+
+size_t SpawnTable::Columns::Find(unsigned spawnId) const
+{
+	if (IdTable.empty())
+	{
+		return Ids.size();
+	}
+	const size_t mask = IdTable.size() - 1;
+	for (size_t slot = HashId(spawnId) & mask;; slot = (slot + 1) & mask)
+	{
+		const auto entry = IdTable[slot];
+		if (entry == 0)
+		{
+			return Ids.size();
+		}
+		if (Ids[entry - 1] == spawnId && Handles[entry - 1])
+		{
+			return entry - 1;
+		}
+	}
+}
+
+void SpawnTable::Columns::Clear()
+{
+	Handles.clear();
+	Ids.clear();
+	Xs.clear();
+	Ys.clear();
+	Hostile.clear();
+	Distances.clear();
+	Bearings.clear();
+	RangeSignatures.clear();
+	MaxRanges.clear();
+	MaxRangesTo.clear();
+	RangesRead.clear();
+}
+
+void SpawnTable::Columns::IndexIds()
+{
+	IdTable.assign(TableSize(Ids.size()), 0);
+	for (size_t i = 0; i < Ids.size(); ++i)
+	{
+		IndexId(i);
+	}
+}
+
+void SpawnTable::Columns::IndexId(size_t index)
+{
+	const size_t mask = IdTable.size() - 1;
+	auto slot = HashId(Ids[index]) & mask;
+	while (IdTable[slot] != 0)
+	{
+		slot = (slot + 1) & mask;
+	}
+	IdTable[slot] = static_cast<uint32_t>(index + 1);
+}
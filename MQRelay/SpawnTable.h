@@ -0,0 +1,108 @@
+#pragma once
+#include "GameState.h"
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+//The zone's spawns as of this update, one pass over the spawn list copied into columns so the sweep can pick
+//what's due from ids and distances without going back to the client for each spawn.
+//It also works out the parts of a spawn that are slow to read one at a time: a mercenary's owner is found by
+//name through an index built the first time one is needed, and melee ranges only change with the size of the
+//spawn or of us, so they're carried over from the last build until the provider's signature for them changes.
+//Distances and bearings from us are worked out for every spawn at once by SpawnGeometry.
+//Walking the whole spawn list is what costs, so Relay builds it as each sweep starts and in between keeps it up
+//to date with the spawns added and removed. A removed spawn's slot stays, empty, so nothing moves under a sweep.
+//Positions are as of the build, or of the last time the spawn was read
+class SpawnTable
+{
+public:
+	//Range checks set one bit per member
+	static constexpr size_t MaxGroupMembers = 8;
+	//What one group member has around it, only hostile spawns count
+	struct MemberProximity
+	{
+		std::string_view Name;
+		//0 when there's nothing hostile in the zone
+		unsigned Nearest = 0;
+		float NearestDistance = 0;
+		unsigned InMelee = 0;
+		unsigned InSpell = 0;
+	};
+
+	explicit SpawnTable(GameStateProvider& state) : _state(state) {}
+
+	void Build();
+	//Reads our group's positions again and adds the spawns that arrived since the last Build or Refresh
+	void Refresh();
+	//A new spawn, added on the next Refresh
+	void Add(SpawnHandle spawn);
+	//Empties the spawn's slot, its handle is no longer good after this
+	void Remove(unsigned spawnId);
+	//Forgets the melee ranges too, for when the zone changes
+	void Clear();
+	//Includes the slots of removed spawns
+	[[nodiscard]] size_t Size() const { return _current.Ids.size(); }
+	//0 for a removed spawn
+	[[nodiscard]] SpawnHandle Handle(size_t index) const { return _current.Handles[index]; }
+	[[nodiscard]] unsigned Id(size_t index) const { return _current.Ids[index]; }
+	//Squared, from the spawn we control
+	[[nodiscard]] float Distance(size_t index) const { return _current.Distances[index]; }
+	//Degrees from us, the same as ${Spawn.HeadingTo}
+	[[nodiscard]] float Bearing(size_t index) const { return _current.Bearings[index]; }
+	//Size() if the spawn isn't in the table
+	[[nodiscard]] size_t Find(unsigned spawnId) const { return _current.Find(spawnId); }
+	//Reads where the spawn is now, for its Distance and Bearing
+	void ReadPosition(size_t index);
+	//ReadSpawn, with OwnerId, Distance, MaxRange and MaxRangeTo filled in from here. Its position is kept too
+	void Read(size_t index, SpawnState& state);
+	//Fills in one entry for each group member in the zone, us first, and returns how many. Ranges aren't squared
+	size_t GroupProximity(float meleeRange, float spellRange, std::array<MemberProximity, MaxGroupMembers>& members);
+
+private:
+	struct Columns
+	{
+		std::vector<SpawnHandle> Handles;
+		std::vector<unsigned> Ids;
+		std::vector<float> Xs;
+		std::vector<float> Ys;
+		std::vector<uint8_t> Hostile;
+		std::vector<float> Distances;
+		std::vector<float> Bearings;
+		//Melee ranges and the signature they were read at, RangesRead is 0 until they have been
+		std::vector<uint64_t> RangeSignatures;
+		std::vector<float> MaxRanges;
+		std::vector<float> MaxRangesTo;
+		std::vector<uint8_t> RangesRead;
+		//Open addressing over Ids, a slot holds the index plus one so 0 is empty. A power of two, at least twice Size
+		std::vector<uint32_t> IdTable;
+
+		[[nodiscard]] size_t Find(unsigned spawnId) const;
+		void Clear();
+		void IndexIds();
+		void IndexId(size_t index);
+	};
+	//Adds the spawn to the columns, without its distance, bearing or an entry in the id table
+	void Append(SpawnHandle spawn);
+	//Distance and bearing from us for one spawn
+	void Measure(size_t index);
+	unsigned FindByName(std::string_view name);
+	void IndexNames();
+	GameStateProvider& _state;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	Columns _current;
+	//The last build, only kept for its melee ranges
+	Columns _previous;
+	//Us first, as of the last build
+	std::array<GroupMemberPosition, MaxGroupMembers> _members;
+	size_t _memberCount = 0;
+	//Spawns added since the last Build or Refresh
+	std::vector<SpawnHandle> _added;
+	//Scratch space for GroupProximity
+	std::vector<float> _memberDistances;
+	std::vector<uint8_t> _meleeMasks;
+	std::vector<uint8_t> _spellMasks;
+	//Names are only indexed when a mercenary's owner is looked up, most updates never need them
+	bool _namesIndexed = false;
+	std::vector<std::string_view> _names;
+	std::vector<uint32_t> _nameTable;
+};
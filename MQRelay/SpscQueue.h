@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//Bounded lock-free queue for exactly one producer thread and one consumer thread
+//Capacity must be a power of two
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+	//Producer only. Moves out of value and returns true if there was room, value is untouched otherwise
+	bool TryPush(T& value)
+	{
+		const auto tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+		_items[tail & (Capacity - 1)] = std::move(value);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer only. Returns false if the queue was empty
+	bool TryPop(T& value)
+	{
+		const auto head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		value = std::move(_items[head & (Capacity - 1)]);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Only exact when called from one of the two owning threads while the other is idle
+	[[nodiscard]] size_t Size() const
+	{
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::array<T, Capacity> _items{};
+	//Each index on its own cache line so the two threads don't fight over it
+	alignas(64) std::atomic<size_t> _head = 0;
+	alignas(64) std::atomic<size_t> _tail = 0;
+};
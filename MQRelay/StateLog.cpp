@@ -0,0 +1,383 @@
+#include "StateLog.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr char Magic[4] = { 'R', 'L', 'O', 'G' };
+constexpr float PositionScale = 100;
+constexpr float HeadingScale = 10;
+
+int64_t Quantize(float value, float scale)
+{
+	return std::llround(value * scale);
+}
+
+float Restore(int64_t value, float scale)
+{
+	return static_cast<float>(value) / scale;
+}
+
+void WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+//Small differences either way become small numbers, -1 is 1 and 1 is 2
+void WriteDelta(std::vector<uint8_t>& out, int64_t value, int64_t previous)
+{
+	const auto delta = static_cast<uint64_t>(value) - static_cast<uint64_t>(previous);
+	WriteVarint(out, (delta << 1) ^ (0 - (delta >> 63)));
+}
+
+//A varint with a bit for each value that changed, then the differences of just those
+template <size_t N>
+void WriteDeltas(std::vector<uint8_t>& out, const std::array<int64_t, N>& values, const std::array<int64_t, N>* previous)
+{
+	static_assert(N <= 64);
+	uint64_t changed = 0;
+	for (size_t i = 0; i < N; ++i)
+	{
+		changed |= static_cast<uint64_t>(values[i] != (previous ? (*previous)[i] : 0)) << i;
+	}
+	WriteVarint(out, changed);
+	for (size_t i = 0; i < N; ++i)
+	{
+		if (changed & (1ULL << i))
+		{
+			WriteDelta(out, values[i], previous ? (*previous)[i] : 0);
+		}
+	}
+}
+
+//Reads the segment's bytes from _data[offset] up to end, a read past the end fails the rest of the frame
+class Reader
+{
+public:
+	Reader(const uint8_t* data, size_t offset, size_t end) : _data(data), _offset(offset), _end(end) {}
+	[[nodiscard]] bool Failed() const { return _failed; }
+	[[nodiscard]] size_t Offset() const { return _offset; }
+
+	uint64_t Varint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (_offset >= _end)
+			{
+				break;
+			}
+			const uint8_t byte = _data[_offset++];
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return value;
+			}
+		}
+		_failed = true;
+		return 0;
+	}
+
+	uint8_t Byte()
+	{
+		if (_offset >= _end)
+		{
+			_failed = true;
+			return 0;
+		}
+		return _data[_offset++];
+	}
+
+	int64_t Delta(int64_t previous)
+	{
+		const uint64_t zigzag = Varint();
+		const uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+		return static_cast<int64_t>(static_cast<uint64_t>(previous) + delta);
+	}
+
+	template <size_t N>
+	void Deltas(std::array<int64_t, N>& values, const std::array<int64_t, N>* previous)
+	{
+		const uint64_t changed = Varint();
+		for (size_t i = 0; i < N; ++i)
+		{
+			const int64_t before = previous ? (*previous)[i] : 0;
+			values[i] = changed & (1ULL << i) ? Delta(before) : before;
+		}
+	}
+
+private:
+	const uint8_t* _data;
+	size_t _offset;
+	size_t _end;
+	bool _failed = false;
+};
+
+StateLog::CharacterValues ToValues(const StateLog::CharacterRecord& character)
+{
+	return { character.CurrentHP, character.CurrentMana, character.CurrentEndurance, character.CastingSpellId,
+			 character.CastingTargetId, character.TargetId, character.PctAggro,
+			 (character.AutoAttacking ? 1 : 0) | (character.AutoFiring ? 2 : 0),
+			 Quantize(character.X, PositionScale), Quantize(character.Y, PositionScale), Quantize(character.Z, PositionScale),
+			 Quantize(character.Heading, HeadingScale) };
+}
+
+void FromValues(const StateLog::CharacterValues& values, StateLog::CharacterRecord& character)
+{
+	character.CurrentHP = values[0];
+	character.CurrentMana = static_cast<int>(values[1]);
+	character.CurrentEndurance = static_cast<int>(values[2]);
+	character.CastingSpellId = static_cast<int>(values[3]);
+	character.CastingTargetId = static_cast<unsigned>(values[4]);
+	character.TargetId = static_cast<unsigned>(values[5]);
+	character.PctAggro = static_cast<int>(values[6]);
+	character.AutoAttacking = values[7] & 1;
+	character.AutoFiring = values[7] & 2;
+	character.X = Restore(values[8], PositionScale);
+	character.Y = Restore(values[9], PositionScale);
+	character.Z = Restore(values[10], PositionScale);
+	character.Heading = Restore(values[11], HeadingScale);
+}
+
+StateLog::XTargetValues ToValues(const StateLog::XTargetRecord& xTarget)
+{
+	return { xTarget.SpawnId, xTarget.AggroPct, xTarget.PctHP };
+}
+
+void FromValues(const StateLog::XTargetValues& values, StateLog::XTargetRecord& xTarget)
+{
+	xTarget.SpawnId = static_cast<unsigned>(values[0]);
+	xTarget.AggroPct = static_cast<int>(values[1]);
+	xTarget.PctHP = values[2];
+}
+
+StateLog::SpawnValues ToValues(const StateLog::SpawnRecord& spawn)
+{
+	return { spawn.SpawnId,
+			 { spawn.MasterId, spawn.OwnerId, spawn.PetId, spawn.Class, spawn.Type, spawn.Level,
+			   Quantize(spawn.X, PositionScale), Quantize(spawn.Y, PositionScale), Quantize(spawn.Z, PositionScale),
+			   Quantize(spawn.Heading, HeadingScale), Quantize(spawn.Speed, PositionScale),
+			   (spawn.Stunned ? 1 : 0) | (spawn.Targetable ? 2 : 0) } };
+}
+
+void FromValues(const StateLog::SpawnValues& values, StateLog::SpawnRecord& spawn)
+{
+	const auto& v = values.Values;
+	spawn.SpawnId = values.SpawnId;
+	spawn.MasterId = static_cast<unsigned>(v[0]);
+	spawn.OwnerId = static_cast<unsigned>(v[1]);
+	spawn.PetId = static_cast<unsigned>(v[2]);
+	spawn.Class = static_cast<int>(v[3]);
+	spawn.Type = static_cast<int>(v[4]);
+	spawn.Level = static_cast<int>(v[5]);
+	spawn.X = Restore(v[6], PositionScale);
+	spawn.Y = Restore(v[7], PositionScale);
+	spawn.Z = Restore(v[8], PositionScale);
+	spawn.Heading = Restore(v[9], HeadingScale);
+	spawn.Speed = Restore(v[10], PositionScale);
+	spawn.Stunned = v[11] & 1;
+	spawn.Targetable = v[11] & 2;
+}
+
+//The spawn with this id in the last frame, both are sorted by id so the search carries on from the last one found
+const StateLog::SpawnValues* FindPrevious(const std::vector<StateLog::SpawnValues>& previous, size_t& cursor, unsigned spawnId)
+{
+	while (cursor < previous.size() && previous[cursor].SpawnId < spawnId)
+	{
+		++cursor;
+	}
+	return cursor < previous.size() && previous[cursor].SpawnId == spawnId ? &previous[cursor] : nullptr;
+}
+}
+
+namespace StateLog
+{
+void Encoder::BeginSegment(long long startTime, std::vector<uint8_t>& out)
+{
+	_segmentStart = startTime;
+	_keyFrame = true;
+	uint8_t header[HeaderSize];
+	memcpy(header, Magic, sizeof(Magic));
+	memcpy(header + 4, &Version, sizeof(Version));
+	const int64_t start = startTime;
+	memcpy(header + 8, &start, sizeof(start));
+	out.insert(out.end(), header, header + HeaderSize);
+}
+
+void Encoder::Encode(Frame& frame, bool keyFrame, std::vector<uint8_t>& out)
+{
+	keyFrame |= _keyFrame;
+	_keyFrame = false;
+	_payload.clear();
+	_payload.push_back(keyFrame ? KeyFrame : 0);
+	WriteVarint(_payload, static_cast<uint64_t>(std::max(0LL, frame.Time - _segmentStart)));
+
+	const auto character = ToValues(frame.Character);
+	WriteDeltas(_payload, character, keyFrame ? nullptr : &_character);
+	_character = character;
+
+	WriteVarint(_payload, frame.XTargets.size());
+	for (size_t i = 0; i < frame.XTargets.size(); ++i)
+	{
+		const auto xTarget = ToValues(frame.XTargets[i]);
+		WriteDeltas(_payload, xTarget, keyFrame || i >= _xTargets.size() ? nullptr : &_xTargets[i]);
+		if (i < _xTargets.size())
+		{
+			_xTargets[i] = xTarget;
+		}
+		else
+		{
+			_xTargets.push_back(xTarget);
+		}
+	}
+	_xTargets.resize(frame.XTargets.size());
+
+	std::sort(frame.Spawns.begin(), frame.Spawns.end(), [](const SpawnRecord& a, const SpawnRecord& b) { return a.SpawnId < b.SpawnId; });
+	WriteVarint(_payload, frame.Spawns.size());
+	_current.clear();
+	size_t cursor = 0;
+	unsigned previousId = 0;
+	for (const auto& record : frame.Spawns)
+	{
+		const auto& spawn = _current.emplace_back(ToValues(record));
+		WriteVarint(_payload, spawn.SpawnId - previousId);
+		previousId = spawn.SpawnId;
+		const SpawnValues* previous = keyFrame ? nullptr : FindPrevious(_spawns, cursor, spawn.SpawnId);
+		WriteDeltas(_payload, spawn.Values, previous ? &previous->Values : nullptr);
+	}
+	std::swap(_spawns, _current);
+
+	WriteVarint(out, _payload.size());
+	out.insert(out.end(), _payload.begin(), _payload.end());
+}
+
+Decoder::Decoder(const uint8_t* data, size_t size) : _data(data), _size(size)
+{
+	uint32_t version = 0;
+	if (size < HeaderSize || memcmp(data, Magic, sizeof(Magic)) != 0)
+	{
+		return;
+	}
+	memcpy(&version, data + 4, sizeof(version));
+	int64_t start = 0;
+	memcpy(&start, data + 8, sizeof(start));
+	_segmentStart = start;
+	_valid = version == Version;
+}
+
+bool Decoder::ReadHeader(FrameInfo& info, size_t& payloadEnd)
+{
+	if (!_valid || _offset >= _size)
+	{
+		return false;
+	}
+	Reader length(_data, _offset, _size);
+	const uint64_t frameLength = length.Varint();
+	if (length.Failed() || frameLength > _size - length.Offset())
+	{
+		return false;
+	}
+	payloadEnd = length.Offset() + static_cast<size_t>(frameLength);
+	Reader header(_data, length.Offset(), payloadEnd);
+	info.Offset = _offset;
+	info.KeyFrame = header.Byte() & KeyFrame;
+	info.Time = _segmentStart + static_cast<long long>(header.Varint());
+	return !header.Failed();
+}
+
+bool Decoder::NextInfo(FrameInfo& info)
+{
+	size_t end = 0;
+	if (!ReadHeader(info, end))
+	{
+		return false;
+	}
+	_offset = end;
+	return true;
+}
+
+void Decoder::Seek(long long time)
+{
+	_offset = HeaderSize;
+	size_t start = HeaderSize;
+	FrameInfo info;
+	while (NextInfo(info) && info.Time <= time)
+	{
+		if (info.KeyFrame)
+		{
+			start = info.Offset;
+		}
+	}
+	_offset = start;
+}
+
+bool Decoder::Next(Frame& frame)
+{
+	FrameInfo info;
+	size_t end = 0;
+	if (!ReadHeader(info, end))
+	{
+		return false;
+	}
+	Reader reader(_data, info.Offset, end);
+	//Past the length, flags and time ReadHeader already checked
+	reader.Varint();
+	reader.Byte();
+	reader.Varint();
+	frame.Time = info.Time;
+	frame.KeyFrame = info.KeyFrame;
+
+	CharacterValues character{};
+	reader.Deltas(character, info.KeyFrame ? nullptr : &_character);
+	FromValues(character, frame.Character);
+	_character = character;
+
+	const auto xTargetCount = static_cast<size_t>(reader.Varint());
+	frame.XTargets.clear();
+	for (size_t i = 0; i < xTargetCount && !reader.Failed(); ++i)
+	{
+		XTargetValues xTarget{};
+		reader.Deltas(xTarget, info.KeyFrame || i >= _xTargets.size() ? nullptr : &_xTargets[i]);
+		if (i < _xTargets.size())
+		{
+			_xTargets[i] = xTarget;
+		}
+		else
+		{
+			_xTargets.push_back(xTarget);
+		}
+		FromValues(xTarget, frame.XTargets.emplace_back());
+	}
+	_xTargets.resize(frame.XTargets.size());
+
+	const auto spawnCount = static_cast<size_t>(reader.Varint());
+	frame.Spawns.clear();
+	_current.clear();
+	size_t cursor = 0;
+	unsigned previousId = 0;
+	for (size_t i = 0; i < spawnCount && !reader.Failed(); ++i)
+	{
+		auto& spawn = _current.emplace_back();
+		spawn.SpawnId = previousId + static_cast<unsigned>(reader.Varint());
+		previousId = spawn.SpawnId;
+		const SpawnValues* previous = info.KeyFrame ? nullptr : FindPrevious(_spawns, cursor, spawn.SpawnId);
+		reader.Deltas(spawn.Values, previous ? &previous->Values : nullptr);
+		FromValues(spawn, frame.Spawns.emplace_back());
+	}
+	std::swap(_spawns, _current);
+	_offset = end;
+	//A frame that doesn't add up leaves the decoder at the end, there's nothing after it we could trust
+	if (reader.Failed())
+	{
+		_offset = _size;
+		return false;
+	}
+	return true;
+}
+}
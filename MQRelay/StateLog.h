@@ -0,0 +1,146 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//The format StateRecorder writes, and the code to read it back. Nothing here knows about MQ or files, a segment
+//is just bytes, so the reader can run straight off a mapped file.
+//
+//A segment is a 16 byte header then frames back to back:
+//  header  "RLOG", uint32 version, int64 milliseconds since the epoch the segment starts at, all little endian
+//  frame   varint length of the rest of the frame, uint8 flags, varint milliseconds since the segment started, payload
+//The payload is the character, then a varint count of XTargets, then a varint count of spawns sorted by id.
+//Each record starts with a varint with a bit set for every value that's different from the same value in the
+//frame before, then a zigzag varint of the difference for each of those, positions in hundredths and headings in
+//tenths of a degree, so something standing still costs a byte or two. A spawn is differenced against itself in
+//the frame before, or against 0 if it wasn't in it, and its id against the id before it in this frame.
+//A key frame is differenced against 0 throughout, every segment starts with one so it can be read on its own,
+//and reading from a key frame needs nothing before it
+namespace StateLog
+{
+constexpr uint32_t Version = 1;
+constexpr size_t HeaderSize = 16;
+constexpr uint8_t KeyFrame = 1;
+
+struct CharacterRecord
+{
+	int64_t CurrentHP = 0;
+	int CurrentMana = 0;
+	int CurrentEndurance = 0;
+	int CastingSpellId = 0;
+	unsigned CastingTargetId = 0;
+	unsigned TargetId = 0;
+	int PctAggro = 0;
+	bool AutoAttacking = false;
+	bool AutoFiring = false;
+	float X = 0;
+	float Y = 0;
+	float Z = 0;
+	float Heading = 0;
+};
+
+struct XTargetRecord
+{
+	unsigned SpawnId = 0;
+	int AggroPct = 0;
+	int64_t PctHP = 0;
+};
+
+struct SpawnRecord
+{
+	unsigned SpawnId = 0;
+	unsigned MasterId = 0;
+	unsigned OwnerId = 0;
+	unsigned PetId = 0;
+	int Class = 0;
+	int Type = 0;
+	int Level = 0;
+	float X = 0;
+	float Y = 0;
+	float Z = 0;
+	float Heading = 0;
+	float Speed = 0;
+	bool Stunned = false;
+	bool Targetable = false;
+};
+
+struct Frame
+{
+	//Milliseconds since the epoch
+	long long Time = 0;
+	//Set by the reader, the writer decides for itself
+	bool KeyFrame = false;
+	CharacterRecord Character;
+	std::vector<XTargetRecord> XTargets;
+	std::vector<SpawnRecord> Spawns;
+};
+
+//Each record as the whole numbers that are differenced, in the order they're written
+constexpr size_t CharacterValueCount = 12;
+constexpr size_t XTargetValueCount = 3;
+constexpr size_t SpawnValueCount = 12;
+using CharacterValues = std::array<int64_t, CharacterValueCount>;
+using XTargetValues = std::array<int64_t, XTargetValueCount>;
+struct SpawnValues
+{
+	unsigned SpawnId = 0;
+	std::array<int64_t, SpawnValueCount> Values{};
+};
+
+class Encoder
+{
+public:
+	//Writes the header and makes the next frame a key frame
+	void BeginSegment(long long startTime, std::vector<uint8_t>& out);
+	//Appends one frame. The frame's spawns are sorted by id, which is why it isn't const
+	void Encode(Frame& frame, bool keyFrame, std::vector<uint8_t>& out);
+
+private:
+	long long _segmentStart = 0;
+	bool _keyFrame = true;
+	CharacterValues _character{};
+	std::vector<XTargetValues> _xTargets;
+	//Sorted by id, swapped with _current once a frame is written so neither reallocates once it's big enough
+	std::vector<SpawnValues> _spawns;
+	std::vector<SpawnValues> _current;
+	std::vector<uint8_t> _payload;
+};
+
+//Reads the frames of one segment in order. The segment's bytes have to outlive the decoder
+class Decoder
+{
+public:
+	//Where a frame starts and what its header says, without decoding the payload
+	struct FrameInfo
+	{
+		size_t Offset = 0;
+		long long Time = 0;
+		bool KeyFrame = false;
+	};
+
+	Decoder(const uint8_t* data, size_t size);
+	//False if the header is missing or from a version we don't read
+	[[nodiscard]] bool Valid() const { return _valid; }
+	[[nodiscard]] long long StartTime() const { return _segmentStart; }
+	//The next frame, false at the end of the segment or at a frame cut short by the writer stopping mid write
+	bool Next(Frame& frame);
+	//The next frame's header, skipping its payload. Don't mix it with Next, Next would decode against the wrong frame
+	bool NextInfo(FrameInfo& info);
+	//Carries on from the last key frame at or before time, or the first frame if there isn't one.
+	//Next then decodes from there, the caller skips frames before time
+	void Seek(long long time);
+
+private:
+	bool ReadHeader(FrameInfo& info, size_t& payloadEnd);
+	const uint8_t* _data;
+	size_t _size;
+	size_t _offset = HeaderSize;
+	bool _valid = false;
+	long long _segmentStart = 0;
+	CharacterValues _character{};
+	std::vector<XTargetValues> _xTargets;
+	std::vector<SpawnValues> _spawns;
+	std::vector<SpawnValues> _current;
+};
+}
@@ -0,0 +1,135 @@
+#include "StateRecorder.h"
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+
+StateRecorder::StateRecorder(RecorderSettings settings, RelayMetrics& metrics)
+	: _settings(std::move(settings)), _metrics(metrics), _thread(&StateRecorder::Run, this)
+{
+}
+
+StateRecorder::~StateRecorder()
+{
+	_running = false;
+	_thread.join();
+}
+
+std::unique_ptr<StateLog::Frame> StateRecorder::Acquire()
+{
+	std::unique_ptr<StateLog::Frame> frame;
+	if (!_free.TryPop(frame))
+	{
+		frame = std::make_unique<StateLog::Frame>();
+	}
+	return frame;
+}
+
+void StateRecorder::Submit(std::unique_ptr<StateLog::Frame>& frame)
+{
+	if (_pending.TryPush(frame))
+	{
+		_metrics.RecordedFrames.Add();
+		return;
+	}
+	//Only the writer hands frames back, so this one is just released
+	_metrics.DroppedFrames.Add();
+	frame.reset();
+}
+
+std::string StateRecorder::LastError() const
+{
+	std::lock_guard lock(_errorMutex);
+	return _lastError;
+}
+
+void StateRecorder::SetError(std::string error)
+{
+	std::lock_guard lock(_errorMutex);
+	_lastError = std::move(error);
+}
+
+bool StateRecorder::Rotate(long long time)
+{
+	Close();
+	std::error_code error;
+	std::filesystem::create_directories(_settings.Directory, error);
+	const auto path = std::filesystem::path(_settings.Directory) / (std::to_string(time) + ".rlog");
+#ifdef _WIN32
+	_file = _wfopen(path.c_str(), L"wb");
+#else
+	_file = std::fopen(path.c_str(), "wb");
+#endif
+	if (!_file)
+	{
+		SetError("Couldn't open " + path.string() + (error ? ": " + error.message() : std::string()));
+		_retryTime = time + RetryInterval;
+		return false;
+	}
+	//Big enough that a segment is written a few frames at a time
+	std::setvbuf(_file, nullptr, _IOFBF, 64 * 1024);  // NOLINT(cert-err33-c)
+	_segmentStart = time;
+	_segmentBytes = 0;
+	_buffer.clear();
+	_encoder.BeginSegment(time, _buffer);
+	return true;
+}
+
+void StateRecorder::Close()
+{
+	if (_file)
+	{
+		std::fclose(_file);  // NOLINT(cert-err33-c)
+		_file = nullptr;
+	}
+}
+
+void StateRecorder::Write(StateLog::Frame& frame)
+{
+	const bool due = !_file || _segmentBytes >= _settings.SegmentSize || frame.Time - _segmentStart >= _settings.SegmentLength;
+	if (due && (frame.Time < _retryTime || !Rotate(frame.Time)))
+	{
+		return;
+	}
+	const bool keyFrame = frame.Time >= _nextKeyFrame;
+	if (keyFrame)
+	{
+		_nextKeyFrame = frame.Time + _settings.KeyFrameFrequency;
+	}
+	_encoder.Encode(frame, keyFrame, _buffer);
+	if (std::fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size())
+	{
+		SetError("Couldn't write to the recording, starting a new segment");
+		Close();
+		_retryTime = frame.Time + RetryInterval;
+		_buffer.clear();
+		return;
+	}
+	_segmentBytes += _buffer.size();
+	_metrics.RecordedBytes.Add(_buffer.size());
+	_buffer.clear();
+	//A crash loses no more than the frames since the last key frame
+	if (keyFrame)
+	{
+		std::fflush(_file);  // NOLINT(cert-err33-c)
+	}
+}
+
+void StateRecorder::Run()
+{
+	std::unique_ptr<StateLog::Frame> frame;
+	//Whatever was submitted before shutdown still gets written
+	while (_running.load(std::memory_order_relaxed) || _pending.Size())
+	{
+		if (!_pending.TryPop(frame))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		Write(*frame);
+		frame->XTargets.clear();
+		frame->Spawns.clear();
+		_free.TryPush(frame);
+		frame.reset();
+	}
+	Close();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "RelayMetrics.h"
+#include "SpscQueue.h"
+#include "StateLog.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RecorderSettings
+{
+	//Segments are written here as <start time>.rlog, it's created if it isn't there
+	std::string Directory;
+	//Milliseconds between key frames
+	unsigned KeyFrameFrequency = 10000;
+	//A segment is finished once it's this big or this many milliseconds old, whichever comes first
+	size_t SegmentSize = 64 * 1024 * 1024;
+	unsigned SegmentLength = 3600000;
+};
+
+//Appends frames to a StateLog on its own thread, so the game thread only fills them in.
+//Frames are handed over and back the way RelayWorker's batches are. If the writer falls behind the frame is
+//dropped rather than waited for, which costs nothing but a gap in the log
+class StateRecorder
+{
+public:
+	StateRecorder(RecorderSettings settings, RelayMetrics& metrics);
+	~StateRecorder();
+	StateRecorder(const StateRecorder&) = delete;
+	StateRecorder& operator=(const StateRecorder&) = delete;
+
+	//Game thread only. Returns an empty frame, reusing one the writer is done with if it can
+	std::unique_ptr<StateLog::Frame> Acquire();
+	//Game thread only. Takes the frame, or counts it as dropped if the writer is behind
+	void Submit(std::unique_ptr<StateLog::Frame>& frame);
+	[[nodiscard]] std::string LastError() const;
+
+private:
+	void Run();
+	void Write(StateLog::Frame& frame);
+	//Finishes the segment being written, if there is one, and starts the next at time
+	bool Rotate(long long time);
+	void Close();
+	void SetError(std::string error);
+	//A segment that couldn't be opened is tried again after this long, frames in between are lost
+	static constexpr long long RetryInterval = 5000;
+	const RecorderSettings _settings;
+	//The writer records RecordedBytes
+	RelayMetrics& _metrics;  // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+	SpscQueue<std::unique_ptr<StateLog::Frame>, 16> _pending;
+	SpscQueue<std::unique_ptr<StateLog::Frame>, 16> _free;
+	std::atomic<bool> _running = true;
+	//Writer thread only
+	StateLog::Encoder _encoder;
+	std::vector<uint8_t> _buffer;
+	std::FILE* _file = nullptr;
+	size_t _segmentBytes = 0;
+	long long _segmentStart = 0;
+	long long _nextKeyFrame = 0;
+	long long _retryTime = 0;
+	mutable std::mutex _errorMutex;
+	std::string _lastError;
+	//Declared last so everything above exists before the thread starts
+	std::thread _thread;
+};
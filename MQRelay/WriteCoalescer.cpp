@@ -0,0 +1,82 @@
+#include "WriteCoalescer.h"
+#include <algorithm>
+#include <string_view>
+
+void WriteCoalescer::Expire(const sw::redis::StringView& key, long long seconds)
+{
+	_keys[FindOrAdd(key)].Expire = seconds;
+	++_expires;
+}
+
+size_t WriteCoalescer::Flush(RelayBatch& batch)
+{
+	size_t commands = 0;
+	for (const auto& writes : _keys)
+	{
+		if (writes.First >= 0)
+		{
+			batch.BeginCommand("HSET");
+			batch.Arg(_args[writes.Key]);
+			for (auto field = writes.First; field >= 0; field = _fields[field].Next)
+			{
+				batch.Arg(_args[_fields[field].Field]);
+				batch.Arg(_args[_fields[field].Field + 1]);
+			}
+			++commands;
+		}
+		if (writes.Expire >= 0)
+		{
+			batch.Expire(_args[writes.Key], writes.Expire);
+			++commands;
+		}
+	}
+	const size_t folded = _fields.size() + _expires - commands;
+	_args.Clear();
+	_keys.clear();
+	_fields.clear();
+	_expires = 0;
+	std::fill(_table.begin(), _table.end(), 0);
+	return folded;
+}
+
+size_t WriteCoalescer::FindOrAdd(const sw::redis::StringView& key)
+{
+	const std::string_view name(key.data(), key.size());
+	const size_t hash = std::hash<std::string_view>()(name);
+	if (_table.size() < (_keys.size() + 1) * 2)
+	{
+		Rehash();
+	}
+	const size_t mask = _table.size() - 1;
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		const auto entry = _table[slot];
+		if (entry == 0)
+		{
+			_table[slot] = static_cast<uint32_t>(_keys.size() + 1);
+			_keys.push_back({ static_cast<uint32_t>(_args.Size()), hash });
+			_args.Add(key);
+			return _keys.size() - 1;
+		}
+		const auto& writes = _keys[entry - 1];
+		if (writes.Hash == hash && std::string_view(_args[writes.Key].data(), _args[writes.Key].size()) == name)
+		{
+			return entry - 1;
+		}
+	}
+}
+
+void WriteCoalescer::Rehash()
+{
+	_table.assign(std::max<size_t>(64, _table.size() * 2), 0);
+	const size_t mask = _table.size() - 1;
+	for (size_t i = 0; i < _keys.size(); ++i)
+	{
+		auto slot = _keys[i].Hash & mask;
+		while (_table[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		_table[slot] = static_cast<uint32_t>(i + 1);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "RelayBatch.h"
+#include <cstdint>
+#include <vector>
+
+//Gathers the hash writes and expiries of one update so every key touched gets one HSET with all of its fields
+//and at most one EXPIRE, however many places wrote to it. Keys come out in the order they were first written
+//and fields in the order they were written, so a field written twice ends up with the later value.
+//Nothing allocates once it has seen a busy update
+class WriteCoalescer
+{
+public:
+	template <typename T>
+	void HSet(const sw::redis::StringView& key, const sw::redis::StringView& field, const T& value)
+	{
+		auto& writes = _keys[FindOrAdd(key)];
+		const auto index = static_cast<int32_t>(_fields.size());
+		_fields.push_back({ static_cast<uint32_t>(_args.Size()), -1 });
+		_args.Add(field);
+		_args.Add(value);
+		if (writes.Last < 0)
+		{
+			writes.First = index;
+		}
+		else
+		{
+			_fields[writes.Last].Next = index;
+		}
+		writes.Last = index;
+	}
+
+	//The last expiry asked for is the one that's set
+	void Expire(const sw::redis::StringView& key, long long seconds);
+	//Adds the commands to the batch and starts over. Returns how many writes were folded into another's command
+	size_t Flush(RelayBatch& batch);
+	[[nodiscard]] bool Empty() const { return _keys.empty(); }
+
+private:
+	struct KeyWrites
+	{
+		//Index of the key in _args
+		uint32_t Key;
+		size_t Hash;
+		//The key's fields as a list through _fields, -1 when there are none
+		int32_t First = -1;
+		int32_t Last = -1;
+		long long Expire = -1;
+	};
+	struct FieldWrite
+	{
+		//Index of the field in _args, its value is the next one
+		uint32_t Field;
+		int32_t Next;
+	};
+	size_t FindOrAdd(const sw::redis::StringView& key);
+	void Rehash();
+	ArgBuffer _args;
+	std::vector<KeyWrites> _keys;
+	std::vector<FieldWrite> _fields;
+	size_t _expires = 0;
+	//Open addressing over _keys, a slot holds the key's index plus one so 0 is empty.
+	//Always a power of two and at least twice the number of keys
+	std::vector<uint32_t> _table;
+};
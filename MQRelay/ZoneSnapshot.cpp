@@ -0,0 +1,180 @@
+#include "ZoneSnapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+template <typename T>
+void Write(std::string& buffer, T value)
+{
+	//Every platform we build for is little endian, which is what the format uses
+	char bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+	buffer.append(bytes, sizeof(T));
+}
+
+template <typename T>
+T Read(const char* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	return value;
+}
+}
+
+namespace ZoneSnapshot
+{
+void Writer::Begin(long long time)
+{
+	_buffer.clear();
+	_names.clear();
+	std::fill(_nameSlots.begin(), _nameSlots.end(), 0);
+	_nameCount = 0;
+	_records = 0;
+	Write(_buffer, Magic);
+	Write(_buffer, Version);
+	Write(_buffer, static_cast<uint16_t>(RecordSize));
+	//Counts are filled in by Finish
+	Write(_buffer, uint32_t{ 0 });
+	Write(_buffer, uint32_t{ 0 });
+	Write(_buffer, static_cast<int64_t>(time));
+}
+
+void Writer::Add(SpawnRecord record, std::string_view name)
+{
+	record.NameIndex = Intern(name.substr(0, UINT8_MAX));
+
+	Write(_buffer, record.SpawnId);
+	Write(_buffer, record.MasterId);
+	Write(_buffer, record.OwnerId);
+	Write(_buffer, record.PetId);
+	Write(_buffer, record.X);
+	Write(_buffer, record.Y);
+	Write(_buffer, record.Z);
+	Write(_buffer, record.Heading);
+	Write(_buffer, record.Distance);
+	Write(_buffer, record.Speed);
+	Write(_buffer, record.MaxRange);
+	Write(_buffer, record.MaxRangeTo);
+	Write(_buffer, record.NameIndex);
+	Write(_buffer, record.Level);
+	Write(_buffer, record.Class);
+	Write(_buffer, record.Type);
+	Write(_buffer, record.Mark);
+	Write(_buffer, record.Flags);
+	Write(_buffer, uint8_t{ 0 });
+	_records++;
+}
+
+std::string_view Writer::Finish()
+{
+	const auto records = _records;
+	const auto names = _nameCount;
+	memcpy(_buffer.data() + 8, &records, sizeof(records));
+	memcpy(_buffer.data() + 12, &names, sizeof(names));
+	_buffer.append(_names);
+	return _buffer;
+}
+
+uint16_t Writer::Intern(std::string_view name)
+{
+	//Kept at most half full so probes stay short
+	if ((_nameCount + 1) * 2 > _nameSlots.size())
+	{
+		GrowNameTable();
+	}
+	const size_t mask = _nameSlots.size() - 1;
+	size_t slot = std::hash<std::string_view>()(name) & mask;
+	while (const auto entry = _nameSlots[slot])
+	{
+		const char* stored = _names.data() + entry - 1;
+		if (std::string_view(stored + 1, static_cast<uint8_t>(*stored)) == name)
+		{
+			return _slotIndexes[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+	_nameSlots[slot] = static_cast<uint32_t>(_names.size()) + 1;
+	_slotIndexes[slot] = static_cast<uint16_t>(_nameCount++);
+	_names.push_back(static_cast<char>(name.size()));
+	_names.append(name);
+	return _slotIndexes[slot];
+}
+
+void Writer::GrowNameTable()
+{
+	const size_t size = std::max<size_t>(_nameSlots.size() * 2, 1024);
+	_nameSlots.assign(size, 0);
+	_slotIndexes.assign(size, 0);
+	//Names are stored in index order so walking them rebuilds the table
+	const size_t mask = size - 1;
+	uint16_t index = 0;
+	for (size_t offset = 0; offset < _names.size(); offset += 1 + static_cast<uint8_t>(_names[offset]))
+	{
+		const std::string_view name(_names.data() + offset + 1, static_cast<uint8_t>(_names[offset]));
+		size_t slot = std::hash<std::string_view>()(name) & mask;
+		while (_nameSlots[slot])
+		{
+			slot = (slot + 1) & mask;
+		}
+		_nameSlots[slot] = static_cast<uint32_t>(offset) + 1;
+		_slotIndexes[slot] = index++;
+	}
+}
+
+bool Decode(std::string_view data, Snapshot& snapshot)
+{
+	if (data.size() < HeaderSize || Read<uint32_t>(data.data()) != Magic || Read<uint16_t>(data.data() + 4) != Version)
+	{
+		return false;
+	}
+	const size_t recordSize = Read<uint16_t>(data.data() + 6);
+	const size_t recordCount = Read<uint32_t>(data.data() + 8);
+	const size_t nameCount = Read<uint32_t>(data.data() + 12);
+	if (recordSize < RecordSize || data.size() < HeaderSize + recordSize * recordCount)
+	{
+		return false;
+	}
+	snapshot.Time = Read<int64_t>(data.data() + 16);
+
+	snapshot.Spawns.resize(recordCount);
+	const char* record = data.data() + HeaderSize;
+	for (auto& spawn : snapshot.Spawns)
+	{
+		spawn.SpawnId = Read<uint32_t>(record);
+		spawn.MasterId = Read<uint32_t>(record + 4);
+		spawn.OwnerId = Read<uint32_t>(record + 8);
+		spawn.PetId = Read<uint32_t>(record + 12);
+		spawn.X = Read<float>(record + 16);
+		spawn.Y = Read<float>(record + 20);
+		spawn.Z = Read<float>(record + 24);
+		spawn.Heading = Read<float>(record + 28);
+		spawn.Distance = Read<float>(record + 32);
+		spawn.Speed = Read<float>(record + 36);
+		spawn.MaxRange = Read<float>(record + 40);
+		spawn.MaxRangeTo = Read<float>(record + 44);
+		spawn.NameIndex = Read<uint16_t>(record + 48);
+		spawn.Level = Read<uint8_t>(record + 50);
+		spawn.Class = Read<uint8_t>(record + 51);
+		spawn.Type = Read<uint8_t>(record + 52);
+		spawn.Mark = Read<uint8_t>(record + 53);
+		spawn.Flags = Read<uint8_t>(record + 54);
+		record += recordSize;
+	}
+
+	snapshot.Names.clear();
+	const char* end = data.data() + data.size();
+	for (size_t i = 0; i < nameCount; ++i)
+	{
+		if (record >= end || record + 1 + static_cast<uint8_t>(*record) > end)
+		{
+			return false;
+		}
+		const auto length = static_cast<uint8_t>(*record);
+		snapshot.Names.emplace_back(record + 1, length);
+		record += 1 + length;
+	}
+	return true;
+}
+}
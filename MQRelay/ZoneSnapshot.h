@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Compact binary encoding of every spawn in a zone, published as a single redis string
+//
+//All values are little endian. Layout for version 1:
+//  Header, 24 bytes
+//    u32 Magic ("TZSN"), u16 Version, u16 RecordSize, u32 RecordCount, u32 NameCount, i64 Time (ms since epoch)
+//  RecordCount spawn records, RecordSize bytes each
+//    u32 SpawnId, u32 MasterId, u32 OwnerId, u32 PetId,
+//    f32 X, f32 Y, f32 Z, f32 Heading, f32 Distance, f32 Speed, f32 MaxRange, f32 MaxRangeTo,
+//    u16 NameIndex, u8 Level, u8 Class, u8 Type, u8 Mark, u8 Flags, u8 Reserved
+//  NameCount names, each a u8 length followed by that many bytes
+//
+//Distance is squared, straight from GetDistanceSquared the same as the spawn hashes' Distance field.
+//Readers must use RecordSize to step between records, later versions only ever append fields
+namespace ZoneSnapshot
+{
+constexpr uint32_t Magic = 0x4E535A54;
+constexpr uint16_t Version = 1;
+constexpr size_t HeaderSize = 24;
+constexpr size_t RecordSize = 56;
+
+enum SpawnFlags : uint8_t
+{
+	Stunned = 1 << 0,
+	Targetable = 1 << 1,
+};
+
+struct SpawnRecord
+{
+	uint32_t SpawnId = 0;
+	uint32_t MasterId = 0;
+	uint32_t OwnerId = 0;
+	uint32_t PetId = 0;
+	float X = 0;
+	float Y = 0;
+	float Z = 0;
+	float Heading = 0;
+	//Squared, from whoever published the snapshot
+	float Distance = 0;
+	float Speed = 0;
+	float MaxRange = 0;
+	float MaxRangeTo = 0;
+	uint16_t NameIndex = 0;
+	uint8_t Level = 0;
+	uint8_t Class = 0;
+	uint8_t Type = 0;
+	uint8_t Mark = 0;
+	uint8_t Flags = 0;
+};
+
+struct Snapshot
+{
+	long long Time = 0;
+	std::vector<SpawnRecord> Spawns;
+	std::vector<std::string> Names;
+};
+
+//Builds a snapshot, names are interned so a zone full of "a_gnoll" only stores it once
+//Keeps its buffers between snapshots so steady state encoding doesn't allocate
+class Writer
+{
+public:
+	void Begin(long long time);
+	void Add(SpawnRecord record, std::string_view name);
+	//The encoded snapshot, valid until the next Begin
+	[[nodiscard]] std::string_view Finish();
+	[[nodiscard]] size_t Count() const { return _records; }
+
+private:
+	uint16_t Intern(std::string_view name);
+	void GrowNameTable();
+	std::string _buffer;
+	std::string _names;
+	//Open addressing table of offsets into _names, plus one so zero means empty.
+	//It's cleared rather than freed between snapshots, which is why this isn't an unordered_map
+	std::vector<uint32_t> _nameSlots;
+	std::vector<uint16_t> _slotIndexes;
+	uint32_t _nameCount = 0;
+	uint32_t _records = 0;
+};
+
+//Returns false if the data isn't a snapshot this version understands
+bool Decode(std::string_view data, Snapshot& snapshot);
+}
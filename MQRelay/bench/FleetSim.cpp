@@ -0,0 +1,328 @@
+//A raid's worth of clients against one redis, to find where redis and the coordinator stop keeping up before a raid does.
+//Characters are put in groups of six and the groups spread over the zones. Each character runs its own Relay against
+//its own synthetic zone, on a thread and connection of its own, and characters in the same zone see the same spawns
+//so the publisher election has the work it has in game. Once a second, and for the whole run at the end, it reports
+//what redis is doing and what the fleet sees, including the Publish timer from an update to redis having its batch.
+//Linux only, it reads its own memory from /proc. Everything it writes is under fleetsim and removed when it finishes
+//
+//relay_fleet [--connection tcp://127.0.0.1:6379] [--characters 54] [--zones 9] [--spawns 600] [--buffs 3] [--xtargets 5]
+//            [--fps 30] [--seconds 60] [--ramp seconds between groups] [--timing Name=value]... [--option Name=value]...
+#include "Relay.h"
+#include "RelaySettings.h"
+#include "SyntheticGameState.h"
+#include <sw/redis++/redis++.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr size_t GroupSize = 6;
+
+struct FleetOptions
+{
+	std::string Connection = "tcp://127.0.0.1:6379";
+	size_t Characters = 54;
+	size_t Zones = 9;
+	size_t Spawns = 600;
+	size_t Buffs = 3;
+	size_t XTargets = 5;
+	unsigned Fps = 30;
+	unsigned Seconds = 60;
+	//Seconds between starting one group and the next, 0 starts everyone at once
+	unsigned Ramp = 0;
+	RelayTimings Timings;
+	RelayOptions Options;
+};
+
+//Sets Name=value on the timings or options, false if neither has Name
+bool SetNamed(std::string_view setting, FleetOptions& fleet)
+{
+	const auto equals = setting.find('=');
+	return equals != std::string_view::npos && RelaySettings::Set(setting.substr(0, equals), setting.substr(equals + 1), fleet.Timings, fleet.Options);
+}
+
+bool ParseArguments(int argc, char** argv, FleetOptions& fleet)
+{
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string_view flag = argv[i];
+		const std::string value = argv[i + 1];
+		if (flag == "--connection")
+		{
+			fleet.Connection = value;
+		}
+		else if (flag == "--characters")
+		{
+			fleet.Characters = std::max<size_t>(1, std::stoul(value));
+		}
+		else if (flag == "--zones")
+		{
+			fleet.Zones = std::max<size_t>(1, std::stoul(value));
+		}
+		else if (flag == "--spawns")
+		{
+			fleet.Spawns = std::stoul(value);
+		}
+		else if (flag == "--buffs")
+		{
+			fleet.Buffs = std::stoul(value);
+		}
+		else if (flag == "--xtargets")
+		{
+			fleet.XTargets = std::stoul(value);
+		}
+		else if (flag == "--fps")
+		{
+			fleet.Fps = std::max(1u, static_cast<unsigned>(std::stoul(value)));
+		}
+		else if (flag == "--seconds")
+		{
+			fleet.Seconds = std::max(1u, static_cast<unsigned>(std::stoul(value)));
+		}
+		else if (flag == "--ramp")
+		{
+			fleet.Ramp = static_cast<unsigned>(std::stoul(value));
+		}
+		else if ((flag == "--timing" || flag == "--option") && SetNamed(value, fleet))
+		{
+			continue;
+		}
+		else
+		{
+			fprintf(stderr, "Don't know %s %s\n", argv[i], argv[i + 1]);
+			return false;
+		}
+	}
+	return argc % 2 == 1;
+}
+
+//One virtual client. Its Relay is made on the main thread and only ever updated by Thread
+struct Character
+{
+	explicit Character(const SyntheticOptions& synthetic) : State(synthetic) {}
+	SyntheticGameState State;
+	std::unique_ptr<Relay> Client;
+	std::thread Thread;
+	//Client's Publish as of the last sample, what it has recorded since is the difference
+	LatencyHistogram PublishSampled;
+};
+
+void RunCharacter(Character& character, unsigned fps, const std::atomic<bool>& running)
+{
+	const auto frame = std::chrono::microseconds(1000000 / fps);
+	auto next = std::chrono::steady_clock::now();
+	Directive directive;
+	while (running.load(std::memory_order_relaxed))
+	{
+		character.State.Step();
+		character.Client->Update();
+		while (character.Client->PopDirective(directive))
+		{
+		}
+		//A client that falls behind doesn't try to catch up, it just runs slower, the way a busy game does
+		next += frame;
+		const auto now = std::chrono::steady_clock::now();
+		if (next < now)
+		{
+			next = now;
+		}
+		std::this_thread::sleep_until(next);
+	}
+}
+
+//A number out of INFO, 0 if it isn't there
+double InfoField(const std::string& info, std::string_view field)
+{
+	size_t at = 0;
+	while ((at = info.find(field, at)) != std::string::npos)
+	{
+		const bool lineStart = at == 0 || info[at - 1] == '\n';
+		at += field.size();
+		if (lineStart && at < info.size() && info[at] == ':')
+		{
+			return std::strtod(info.c_str() + at + 1, nullptr);
+		}
+	}
+	return 0;
+}
+
+//What redis and this process look like at one moment
+struct Sample
+{
+	std::chrono::steady_clock::time_point Time;
+	double RedisCommands = 0;
+	double RedisCpu = 0;
+	double RedisMemory = 0;
+	long long Keys = 0;
+	double OurCpu = 0;
+	double OurMemory = 0;
+	uint64_t Ticks = 0;
+	uint64_t Batches = 0;
+	uint64_t Commands = 0;
+	uint64_t Coalesced = 0;
+	uint64_t Dropped = 0;
+	uint64_t Failed = 0;
+};
+
+Sample TakeSample(sw::redis::Redis& redis, const std::vector<std::unique_ptr<Character>>& characters, size_t started)
+{
+	Sample sample;
+	sample.Time = std::chrono::steady_clock::now();
+	const auto info = redis.info();
+	sample.RedisCommands = InfoField(info, "total_commands_processed");
+	sample.RedisCpu = InfoField(info, "used_cpu_user") + InfoField(info, "used_cpu_sys");
+	sample.RedisMemory = InfoField(info, "used_memory");
+	sample.Keys = redis.dbsize();
+	rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+	sample.OurCpu = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	std::ifstream statm("/proc/self/statm");
+	double pages = 0;
+	statm >> pages >> pages;
+	sample.OurMemory = pages * static_cast<double>(sysconf(_SC_PAGESIZE));
+	for (size_t i = 0; i < started; ++i)
+	{
+		auto& metrics = characters[i]->Client->Metrics();
+		sample.Ticks += metrics.Ticks.Value();
+		sample.Batches += metrics.Batches.Value();
+		sample.Commands += metrics.Commands.Value();
+		sample.Coalesced += metrics.CoalescedUpdates.Value();
+		sample.Dropped += metrics.DroppedBatches.Value();
+		sample.Failed += metrics.FailedBatches.Value();
+	}
+	return sample;
+}
+
+double Megabytes(double bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+}
+
+int main(int argc, char** argv)
+{
+	FleetOptions fleet;
+	if (!ParseArguments(argc, argv, fleet))
+	{
+		fprintf(stderr, "relay_fleet [--connection url] [--characters n] [--zones n] [--spawns n] [--buffs n] [--xtargets n] [--fps n]\n"
+						"            [--seconds n] [--ramp seconds] [--timing Name=value]... [--option Name=value]...\n");
+		return 2;
+	}
+
+	try
+	{
+		sw::redis::Redis redis(fleet.Connection);
+		std::vector<std::unique_ptr<Character>> characters;
+		for (size_t i = 0; i < fleet.Characters; ++i)
+		{
+			const size_t group = i / GroupSize;
+			SyntheticOptions synthetic;
+			synthetic.Spawns = fleet.Spawns;
+			synthetic.BuffsPerDebuffedSpawn = fleet.Buffs;
+			synthetic.XTargets = fleet.XTargets;
+			synthetic.Server = "fleetsim";
+			synthetic.Zone = "zone" + std::to_string(group % fleet.Zones);
+			synthetic.Character = "fleetsim" + std::to_string(i);
+			synthetic.Leader = "fleetsim" + std::to_string(group * GroupSize);
+			characters.push_back(std::make_unique<Character>(synthetic));
+		}
+
+		printf("%zu characters in %zu zones, %zu spawns, %zu buffs per debuffed spawn, %zu xtargets, %u updates a second, %us\n",
+			   fleet.Characters, std::min(fleet.Zones, (fleet.Characters + GroupSize - 1) / GroupSize), fleet.Spawns, fleet.Buffs, fleet.XTargets, fleet.Fps, fleet.Seconds);
+		printf("%5s %5s %9s %8s %9s %8s %7s %8s %9s %9s %9s %6s %8s %8s %8s\n", "sec", "chars", "redis op", "redis %", "redis MB", "keys", "our %",
+			   "our MB", "ticks", "commands", "coalesced", "lost", "pub p50", "pub p99", "pub max");
+
+		std::atomic<bool> running = true;
+		size_t started = 0;
+		LatencyHistogram total;
+		const auto start = std::chrono::steady_clock::now();
+		const auto first = TakeSample(redis, characters, started);
+		auto previous = first;
+		//Characters times seconds they were running for, so a ramp doesn't drag the average down
+		double characterSeconds = 0;
+		double peakRedisCpu = 0;
+		double peakRedisMemory = 0;
+		long long peakKeys = 0;
+		for (unsigned second = 1; second <= fleet.Seconds; ++second)
+		{
+			//Groups join as the ramp says, every group at once without one
+			const size_t due = fleet.Ramp ? std::min(fleet.Characters, ((second - 1) / fleet.Ramp + 1) * GroupSize) : fleet.Characters;
+			for (; started < due; ++started)
+			{
+				auto& character = *characters[started];
+				character.Client = std::make_unique<Relay>(fleet.Connection, character.State, fleet.Timings, fleet.Options);
+				character.Thread = std::thread(RunCharacter, std::ref(character), fleet.Fps, std::cref(running));
+			}
+			std::this_thread::sleep_until(start + std::chrono::seconds(second));
+
+			const auto sample = TakeSample(redis, characters, started);
+			LatencyHistogram window;
+			for (size_t i = 0; i < started; ++i)
+			{
+				//Only reads the worker's histogram, a batch it's recording right now is counted next second
+				auto& character = *characters[i];
+				window.MergeSince(character.Client->Metrics().Publish, character.PublishSampled);
+			}
+			total.Merge(window);
+			const double seconds = std::chrono::duration<double>(sample.Time - previous.Time).count();
+			characterSeconds += seconds * static_cast<double>(started);
+			const double redisCpu = (sample.RedisCpu - previous.RedisCpu) / seconds * 100;
+			peakRedisCpu = std::max(peakRedisCpu, redisCpu);
+			peakRedisMemory = std::max(peakRedisMemory, sample.RedisMemory);
+			peakKeys = std::max(peakKeys, sample.Keys);
+			printf("%5u %5zu %9.0f %8.1f %9.1f %8lld %7.1f %8.1f %9.0f %9.0f %9llu %6llu %7lluus %7lluus %7lluus\n", second, started,
+				   (sample.RedisCommands - previous.RedisCommands) / seconds, redisCpu, Megabytes(sample.RedisMemory), sample.Keys,
+				   (sample.OurCpu - previous.OurCpu) / seconds * 100, Megabytes(sample.OurMemory),
+				   static_cast<double>(sample.Ticks - previous.Ticks) / seconds, static_cast<double>(sample.Commands - previous.Commands) / seconds,
+				   static_cast<unsigned long long>(sample.Coalesced - previous.Coalesced),
+				   static_cast<unsigned long long>(sample.Dropped - previous.Dropped + sample.Failed - previous.Failed),
+				   static_cast<unsigned long long>(window.Percentile(50)), static_cast<unsigned long long>(window.Percentile(99)),
+				   static_cast<unsigned long long>(window.Max()));
+			fflush(stdout);
+			previous = sample;
+		}
+
+		running = false;
+		for (size_t i = 0; i < started; ++i)
+		{
+			characters[i]->Thread.join();
+		}
+		const double seconds = std::chrono::duration<double>(previous.Time - first.Time).count();
+		printf("Over %.0fs\n", seconds);
+		printf("  redis  %.0f commands/sec, CPU peak %.1f%%, memory peak %.1fMB, keys peak %lld\n",
+			   (previous.RedisCommands - first.RedisCommands) / seconds, peakRedisCpu, Megabytes(peakRedisMemory), peakKeys);
+		printf("  fleet  %.1f updates/sec per character of %u, %.0f batches/sec, %.0f commands/sec, %llu updates coalesced, %llu dropped, %llu failed\n",
+			   static_cast<double>(previous.Ticks - first.Ticks) / characterSeconds, fleet.Fps,
+			   static_cast<double>(previous.Batches - first.Batches) / seconds, static_cast<double>(previous.Commands - first.Commands) / seconds,
+			   static_cast<unsigned long long>(previous.Coalesced - first.Coalesced), static_cast<unsigned long long>(previous.Dropped - first.Dropped),
+			   static_cast<unsigned long long>(previous.Failed - first.Failed));
+		printf("  publish p50 %lluus, p99 %lluus, max %lluus over %llu batches\n", static_cast<unsigned long long>(total.Percentile(50)),
+			   static_cast<unsigned long long>(total.Percentile(99)), static_cast<unsigned long long>(total.Max()),
+			   static_cast<unsigned long long>(total.Count()));
+		//The workers send what they still have as they stop
+		characters.clear();
+
+		for (const char* pattern : { "fleetsim:*", "fleetsim[0-9]*" })
+		{
+			redis.eval<long long>("local keys = redis.call('KEYS', ARGV[1]) for _, key in ipairs(keys) do redis.call('UNLINK', key) end return #keys",
+								  {}, { pattern });
+		}
+	}
+	catch (const sw::redis::Error& e)
+	{
+		fprintf(stderr, "redis: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,148 @@
+//Times SpawnGeometry against the scalar code it replaces, GetDistanceSquared and the ${Spawn.HeadingTo} math
+//once per spawn, and checks they agree. Needs nothing but a compiler, build with -mavx2 or /arch:AVX2 for the AVX2 path
+//
+//relay_geometry_bench [spawns] [group members] [passes]
+#include "SpawnGeometry.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Zone
+{
+	std::vector<float> Xs;
+	std::vector<float> Ys;
+	//The first member is us
+	std::vector<float> MemberXs;
+	std::vector<float> MemberYs;
+};
+
+//What MQ does for one spawn
+float ScalarBearing(float fromX, float fromY, float x, float y)
+{
+	float bearing = std::atan2(fromY - y, x - fromX) * 180.0f / 3.14159265359f + 90.0f;
+	if (bearing < 0.0f)
+	{
+		bearing += 360.0f;
+	}
+	else if (bearing >= 360.0f)
+	{
+		bearing -= 360.0f;
+	}
+	return bearing;
+}
+
+void RunScalar(const Zone& zone, float meleeRange, float spellRange, std::vector<float>& distances, std::vector<float>& bearings,
+			   std::vector<uint8_t>& melee, std::vector<uint8_t>& spell)
+{
+	std::fill(melee.begin(), melee.end(), 0);
+	std::fill(spell.begin(), spell.end(), 0);
+	for (size_t i = 0; i < zone.Xs.size(); ++i)
+	{
+		for (size_t m = 0; m < zone.MemberXs.size(); ++m)
+		{
+			const float dx = zone.MemberXs[m] - zone.Xs[i];
+			const float dy = zone.MemberYs[m] - zone.Ys[i];
+			const float distance = dx * dx + dy * dy;
+			if (m == 0)
+			{
+				distances[i] = distance;
+				bearings[i] = ScalarBearing(zone.MemberXs[m], zone.MemberYs[m], zone.Xs[i], zone.Ys[i]);
+			}
+			melee[i] |= distance <= meleeRange ? static_cast<uint8_t>(1 << m) : 0;
+			spell[i] |= distance <= spellRange ? static_cast<uint8_t>(1 << m) : 0;
+		}
+	}
+}
+
+void RunKernel(const Zone& zone, float meleeRange, float spellRange, std::vector<float>& distances, std::vector<float>& bearings,
+			   std::vector<float>& memberDistances, std::vector<uint8_t>& melee, std::vector<uint8_t>& spell)
+{
+	const size_t count = zone.Xs.size();
+	std::fill(melee.begin(), melee.end(), 0);
+	std::fill(spell.begin(), spell.end(), 0);
+	SpawnGeometry::DistancesSquared(zone.Xs.data(), zone.Ys.data(), count, zone.MemberXs[0], zone.MemberYs[0], distances.data());
+	SpawnGeometry::Bearings(zone.Xs.data(), zone.Ys.data(), count, zone.MemberXs[0], zone.MemberYs[0], bearings.data());
+	for (size_t m = 0; m < zone.MemberXs.size(); ++m)
+	{
+		const float* member = distances.data();
+		if (m > 0)
+		{
+			SpawnGeometry::DistancesSquared(zone.Xs.data(), zone.Ys.data(), count, zone.MemberXs[m], zone.MemberYs[m], memberDistances.data());
+			member = memberDistances.data();
+		}
+		const auto bit = static_cast<uint8_t>(1 << m);
+		SpawnGeometry::MarkWithin(member, count, meleeRange, bit, melee.data());
+		SpawnGeometry::MarkWithin(member, count, spellRange, bit, spell.data());
+	}
+}
+
+template <typename F>
+double NanosecondsPerSpawn(size_t spawns, int passes, F&& pass)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < passes; ++i)
+	{
+		pass();
+	}
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / passes / static_cast<double>(spawns);
+}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t spawns = argc > 1 ? std::stoul(argv[1]) : 600;
+	const size_t members = std::clamp<size_t>(argc > 2 ? std::stoul(argv[2]) : 6, 1, 8);
+	const int passes = argc > 3 ? std::max(1, std::stoi(argv[3])) : 2000;
+	constexpr float meleeRange = 25 * 25;
+	constexpr float spellRange = 200 * 200;
+
+	Zone zone;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> coordinate(-1500, 1500);
+	std::uniform_real_distribution<float> nearby(-40, 40);
+	for (size_t i = 0; i < spawns; ++i)
+	{
+		zone.Xs.push_back(coordinate(random));
+		zone.Ys.push_back(coordinate(random));
+	}
+	for (size_t m = 0; m < members; ++m)
+	{
+		zone.MemberXs.push_back(nearby(random));
+		zone.MemberYs.push_back(nearby(random));
+	}
+
+	std::vector<float> scalarDistances(spawns), scalarBearings(spawns), kernelDistances(spawns), kernelBearings(spawns), memberDistances(spawns);
+	std::vector<uint8_t> scalarMelee(spawns), scalarSpell(spawns), kernelMelee(spawns), kernelSpell(spawns);
+	RunScalar(zone, meleeRange, spellRange, scalarDistances, scalarBearings, scalarMelee, scalarSpell);
+	RunKernel(zone, meleeRange, spellRange, kernelDistances, kernelBearings, memberDistances, kernelMelee, kernelSpell);
+
+	float bearingError = 0;
+	size_t mismatches = 0;
+	for (size_t i = 0; i < spawns; ++i)
+	{
+		//Either side of north is the same direction
+		const float difference = std::fabs(scalarBearings[i] - kernelBearings[i]);
+		bearingError = std::max(bearingError, std::min(difference, 360.0f - difference));
+		mismatches += scalarDistances[i] != kernelDistances[i] || scalarMelee[i] != kernelMelee[i] || scalarSpell[i] != kernelSpell[i];
+	}
+
+	const double scalar = NanosecondsPerSpawn(spawns, passes, [&] {
+		RunScalar(zone, meleeRange, spellRange, scalarDistances, scalarBearings, scalarMelee, scalarSpell);
+	});
+	const double kernel = NanosecondsPerSpawn(spawns, passes, [&] {
+		RunKernel(zone, meleeRange, spellRange, kernelDistances, kernelBearings, memberDistances, kernelMelee, kernelSpell);
+	});
+
+	printf("%zu spawns, %zu group members, %d passes, %s\n", spawns, members, passes, SpawnGeometry::InstructionSet());
+	printf("  Scalar  %8.2fns per spawn\n", scalar);
+	printf("  Kernel  %8.2fns per spawn, %.1fx\n", kernel, scalar / kernel);
+	printf("  Largest bearing difference %.4f degrees, %zu spawns with different distances or ranges\n", bearingError, mismatches);
+	return bearingError < 0.01f && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+//Runs Relay::Update against a synthetic zone and a local redis-server
+//Every update runs every tick, which is the worst case a client sees. Everything it writes is under relaybench: and removed when it finishes
+//
+//relay_bench [connection string] [spawns] [buffs per debuffed spawn] [xtargets] [ticks] [recorder directory]
+//A recorder directory turns on RelayOptions::Recorder, recording every tick into it
+//Before timing anything it checks that a zone snapshot of the synthetic zone decodes to what was encoded, and exits with 1 if not
+#include "Relay.h"
+#include "SyntheticGameState.h"
+#include "ZoneSnapshot.h"
+#include <sw/redis++/redis++.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+//Only the thread running Relay::Update is counted, the worker and redis++ allocate on their own
+thread_local uint64_t allocations = 0;
+thread_local uint64_t allocatedBytes = 0;
+
+void* CountedAllocate(size_t size)
+{
+	allocations++;
+	allocatedBytes += size;
+	if (void* memory = std::malloc(size ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+//Encodes the synthetic zone the way Relay does and checks Decode gives back exactly what went in
+bool CheckSnapshotRoundTrip(SyntheticGameState& state)
+{
+	constexpr long long time = 1700000000123;
+	ZoneSnapshot::Writer writer;
+	writer.Begin(time);
+	std::vector<ZoneSnapshot::SpawnRecord> records;
+	std::vector<std::string> names;
+	SpawnState spawn;
+	for (auto handle = state.FirstSpawn(); handle; handle = state.NextSpawn(handle))
+	{
+		state.ReadSpawn(handle, spawn);
+		ZoneSnapshot::SpawnRecord record;
+		record.SpawnId = spawn.SpawnId;
+		record.MasterId = spawn.MasterId;
+		record.OwnerId = spawn.SpawnId + 1;
+		record.PetId = spawn.PetId;
+		record.X = spawn.X;
+		record.Y = spawn.Y;
+		record.Z = spawn.Z;
+		record.Heading = spawn.Heading;
+		//Squared, the same as Relay publishes
+		record.Distance = spawn.X * spawn.X + spawn.Y * spawn.Y;
+		record.Speed = spawn.Speed;
+		record.MaxRange = spawn.X / 7;
+		record.MaxRangeTo = spawn.Y / 3;
+		record.Level = static_cast<uint8_t>(spawn.Level);
+		record.Class = static_cast<uint8_t>(spawn.Class);
+		record.Type = static_cast<uint8_t>(spawn.Type);
+		record.Mark = static_cast<uint8_t>(records.size() % 4);
+		record.Flags = (spawn.Stunned ? ZoneSnapshot::Stunned : 0) | (spawn.Targetable ? ZoneSnapshot::Targetable : 0);
+		writer.Add(record, spawn.Name);
+		records.push_back(record);
+		names.emplace_back(spawn.Name);
+	}
+
+	ZoneSnapshot::Snapshot snapshot;
+	if (!ZoneSnapshot::Decode(writer.Finish(), snapshot) || snapshot.Time != time || snapshot.Spawns.size() != records.size())
+	{
+		fprintf(stderr, "zone snapshot didn't decode, %zu of %zu spawns\n", snapshot.Spawns.size(), records.size());
+		return false;
+	}
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const auto& expected = records[i];
+		const auto& decoded = snapshot.Spawns[i];
+		const bool same = decoded.SpawnId == expected.SpawnId && decoded.MasterId == expected.MasterId && decoded.OwnerId == expected.OwnerId &&
+						  decoded.PetId == expected.PetId && decoded.X == expected.X && decoded.Y == expected.Y && decoded.Z == expected.Z &&
+						  decoded.Heading == expected.Heading && decoded.Distance == expected.Distance && decoded.Speed == expected.Speed &&
+						  decoded.MaxRange == expected.MaxRange && decoded.MaxRangeTo == expected.MaxRangeTo && decoded.Level == expected.Level &&
+						  decoded.Class == expected.Class && decoded.Type == expected.Type && decoded.Mark == expected.Mark && decoded.Flags == expected.Flags &&
+						  decoded.NameIndex < snapshot.Names.size() && snapshot.Names[decoded.NameIndex] == names[i];
+		if (!same)
+		{
+			fprintf(stderr, "zone snapshot record %zu, spawn %u, didn't survive the round trip\n", i, expected.SpawnId);
+			return false;
+		}
+	}
+	return true;
+}
+
+void PrintTimer(const char* name, const LatencyHistogram& histogram)
+{
+	printf("  %-14s p50 %7lluus  p99 %7lluus  max %7lluus  %8llu samples\n", name,
+		   static_cast<unsigned long long>(histogram.Percentile(50)), static_cast<unsigned long long>(histogram.Percentile(99)),
+		   static_cast<unsigned long long>(histogram.Max()), static_cast<unsigned long long>(histogram.Count()));
+}
+}
+
+void* operator new(size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+int main(int argc, char** argv)
+{
+	const std::string connection = argc > 1 ? argv[1] : "tcp://127.0.0.1:6379";
+	SyntheticOptions synthetic;
+	synthetic.Spawns = argc > 2 ? std::stoul(argv[2]) : 600;
+	synthetic.BuffsPerDebuffedSpawn = argc > 3 ? std::stoul(argv[3]) : 3;
+	synthetic.XTargets = argc > 4 ? std::stoul(argv[4]) : 5;
+	const int ticks = argc > 5 ? std::max(1, std::stoi(argv[5])) : 1000;
+	//Long enough for every buffer to grow to fit the zone
+	constexpr int warmupTicks = 50;
+
+	RelayTimings timings;
+	timings.CharacterStatsUpdateFrequency = 0;
+	timings.CharacterStateUpdateFrequency = 0;
+	timings.SpawnEngagedUpdateFrequency = 0;
+	timings.SpawnNearUpdateFrequency = 0;
+	timings.SpawnMovingUpdateFrequency = 0;
+	timings.SpawnsUpdateFrequency = 0;
+	timings.ZoneSnapshotUpdateFrequency = 0;
+	//The whole zone every update, so a tick's cost isn't spread over the next ones
+	timings.SpawnSweepBudget = 0;
+	timings.XTargetUpdateFrequency = 0;
+	timings.BuffUpdateFrequency = 0;
+	RelayOptions options;
+	if (argc > 6)
+	{
+		options.Recorder = true;
+		options.RecorderDirectory = argv[6];
+		timings.RecorderFrequency = 0;
+	}
+
+	try
+	{
+		SyntheticGameState state(synthetic);
+		if (!CheckSnapshotRoundTrip(state))
+		{
+			return 1;
+		}
+		{
+			Relay relay(connection, state, timings, options);
+			for (int i = 0; i < warmupTicks; ++i)
+			{
+				state.Step();
+				relay.Update();
+			}
+			relay.Metrics().Reset();
+			allocations = 0;
+			allocatedBytes = 0;
+
+			const auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < ticks; ++i)
+			{
+				state.Step();
+				relay.Update();
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			const uint64_t tickAllocations = allocations;
+			const uint64_t tickAllocatedBytes = allocatedBytes;
+
+			//Let the worker finish what it was given so Exec covers every batch
+			auto& metrics = relay.Metrics();
+			for (int wait = 0; wait < 10000 && metrics.Exec.Count() < metrics.Batches.Value(); ++wait)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			printf("%zu spawns, %zu buffs per debuffed spawn, %zu xtargets, %d ticks\n", synthetic.Spawns, synthetic.BuffsPerDebuffedSpawn, synthetic.XTargets, ticks);
+			printf("  %.0f ticks/sec\n", ticks / seconds);
+			metrics.ForEachTimer(PrintTimer);
+			const auto batches = std::max<uint64_t>(metrics.Batches.Value(), 1);
+			printf("  %.2f allocations and %.0f bytes allocated per tick on the game thread\n",
+				   static_cast<double>(tickAllocations) / ticks, static_cast<double>(tickAllocatedBytes) / ticks);
+			printf("  %llu batches, %.0f commands and %.0f argument bytes per batch, %llu coalesced, %llu dropped, %llu failed\n",
+				   static_cast<unsigned long long>(metrics.Batches.Value()),
+				   static_cast<double>(metrics.Commands.Value()) / batches, static_cast<double>(metrics.Bytes.Value()) / batches,
+				   static_cast<unsigned long long>(metrics.CoalescedUpdates.Value()), static_cast<unsigned long long>(metrics.DroppedBatches.Value()),
+				   static_cast<unsigned long long>(metrics.FailedBatches.Value()));
+			printf("  %llu of %llu spawn fields sent\n", static_cast<unsigned long long>(metrics.SpawnFieldsSent.Value()),
+				   static_cast<unsigned long long>(metrics.SpawnsVisited.Value() * SpawnFieldCount));
+			if (options.Recorder)
+			{
+				printf("  %llu frames recorded, %llu dropped, %.0f bytes per frame written\n", static_cast<unsigned long long>(metrics.RecordedFrames.Value()),
+					   static_cast<unsigned long long>(metrics.DroppedFrames.Value()),
+					   static_cast<double>(metrics.RecordedBytes.Value()) / static_cast<double>(std::max<uint64_t>(metrics.RecordedFrames.Value(), 1)));
+			}
+		}
+
+		sw::redis::Redis redis(connection);
+		redis.eval<long long>("local keys = redis.call('KEYS', ARGV[1]) for _, key in ipairs(keys) do redis.call('UNLINK', key) end return #keys",
+							  {}, { "relaybench:*" });
+	}
+	catch (const sw::redis::Error& e)
+	{
+		fprintf(stderr, "redis error: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
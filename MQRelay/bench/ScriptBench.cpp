@@ -0,0 +1,172 @@
+//Compares publishing spawns with one script call per spawn and buff against one SpawnBulk call per tick
+//Run against a local redis-server, everything it writes is under relaybench: and removed when it finishes
+//
+//relay_script_bench [connection string] [ticks per run]
+#include "RelayScripts.h"
+#include <sw/redis++/redis++.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr const char* KeyPrefix = "relaybench:zone:spawns:";
+constexpr const char* FieldNames[] = {
+	"Class", "Type", "Name", "Heading", "Level", "Mark", "MasterId", "OwnerId", "PetId",
+	"MaxRange", "MaxRangeTo", "Speed", "Stunned", "Targetable", "X", "Y", "Z"
+};
+constexpr int BuffsPerDebuffedSpawn = 3;
+
+struct SyntheticBuff
+{
+	std::string Slot;
+	std::string Staleness;
+	std::string SpellId;
+	std::string Caster;
+	std::string Duration;
+};
+
+struct SyntheticSpawn
+{
+	std::string Id;
+	std::string Distance;
+	std::vector<std::string> Values;
+	std::vector<SyntheticBuff> Buffs;
+};
+
+//Every fourth spawn is debuffed, which is roughly what a raid pull looks like
+std::vector<SyntheticSpawn> MakeSpawns(int count)
+{
+	std::vector<SyntheticSpawn> spawns(count);
+	for (int i = 0; i < count; ++i)
+	{
+		auto& spawn = spawns[i];
+		spawn.Id = std::to_string(1000 + i);
+		spawn.Distance = std::to_string(50 + i % 400) + ".00";
+		spawn.Values = {
+			std::to_string(i % 16 + 1), "1", "a_synthetic_mob" + std::to_string(i), "180.00", std::to_string(i % 120 + 1), "0",
+			"0", "0", "0", "14.00", "16.00", "0.00", "0", "1",
+			std::to_string(i * 3) + ".25", std::to_string(-i * 2) + ".50", "12.00"
+		};
+		if (i % 4 == 0)
+		{
+			for (int b = 0; b < BuffsPerDebuffedSpawn; ++b)
+			{
+				spawn.Buffs.push_back({ std::to_string(b), "100", std::to_string(2000 + b), "Synthetic", "60000" });
+			}
+		}
+	}
+	return spawns;
+}
+
+long long RunPerSpawn(sw::redis::Redis& redis, const std::string& spawnSha, const std::string& buffSha, const std::vector<SyntheticSpawn>& spawns, long long time)
+{
+	const auto timeString = std::to_string(time);
+	auto pipe = redis.pipeline(false);
+	long long calls = 0;
+	std::vector<sw::redis::StringView> args;
+	for (const auto& spawn : spawns)
+	{
+		const std::string key = KeyPrefix + spawn.Id;
+		args.clear();
+		args.emplace_back(timeString);
+		args.emplace_back(spawn.Distance);
+		args.emplace_back("60");
+		for (size_t f = 0; f < spawn.Values.size(); ++f)
+		{
+			args.emplace_back(FieldNames[f]);
+			args.emplace_back(spawn.Values[f]);
+		}
+		const sw::redis::StringView keyView(key);
+		pipe.evalsha(spawnSha, &keyView, &keyView + 1, args.begin(), args.end());
+		calls++;
+		for (const auto& buff : spawn.Buffs)
+		{
+			pipe.evalsha(buffSha, { key + ":buffs:" + buff.Slot }, { buff.Staleness, timeString, buff.SpellId, buff.Caster, buff.Duration });
+			calls++;
+		}
+	}
+	pipe.exec();
+	return calls;
+}
+
+long long RunBulk(sw::redis::Redis& redis, const std::string& bulkSha, const std::vector<SyntheticSpawn>& spawns, long long time)
+{
+	std::vector<std::string> payload = { std::to_string(time), "60", "0" };
+	for (const auto& spawn : spawns)
+	{
+		payload.push_back(spawn.Id);
+		payload.push_back(spawn.Distance);
+		payload.push_back(std::to_string(spawn.Values.size()));
+		for (size_t f = 0; f < spawn.Values.size(); ++f)
+		{
+			payload.emplace_back(FieldNames[f]);
+			payload.push_back(spawn.Values[f]);
+		}
+		payload.push_back(std::to_string(spawn.Buffs.size()));
+		for (const auto& buff : spawn.Buffs)
+		{
+			payload.insert(payload.end(), { buff.Slot, buff.Staleness, buff.SpellId, buff.Caster, buff.Duration });
+		}
+	}
+	const sw::redis::StringView prefix(KeyPrefix);
+	auto pipe = redis.pipeline(false);
+	pipe.evalsha(bulkSha, &prefix, &prefix + 1, payload.begin(), payload.end());
+	pipe.exec();
+	return 1;
+}
+
+template <typename Func>
+void Report(const char* name, int spawnCount, int ticks, Func tick)
+{
+	std::vector<double> samples;
+	long long calls = 0;
+	for (int i = 0; i < ticks; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		//Each tick is 600ms apart so the scripts always decide to write, the worst case
+		calls = tick(1'000'000LL + i * 600LL);
+		samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(samples.begin(), samples.end());
+	double total = 0;
+	for (const auto sample : samples)
+	{
+		total += sample;
+	}
+	printf("%-9s %6d spawns %6lld calls/tick  mean %8.3fms  p50 %8.3fms  p99 %8.3fms  max %8.3fms\n", name, spawnCount, calls,
+		   total / ticks, samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string connection = argc > 1 ? argv[1] : "tcp://127.0.0.1:6379";
+	const int ticks = argc > 2 ? std::max(1, std::stoi(argv[2])) : 50;
+
+	try
+	{
+		sw::redis::Redis redis(connection);
+		const auto spawnSha = redis.script_load(RelayScripts::Spawn);
+		const auto buffSha = redis.script_load(RelayScripts::SpawnBuffs);
+		const auto bulkSha = redis.script_load(RelayScripts::SpawnBulk);
+
+		for (const int spawnCount : { 100, 600, 3000 })
+		{
+			const auto spawns = MakeSpawns(spawnCount);
+			Report("per-spawn", spawnCount, ticks, [&](long long time) { return RunPerSpawn(redis, spawnSha, buffSha, spawns, time); });
+			Report("bulk", spawnCount, ticks, [&](long long time) { return RunBulk(redis, bulkSha, spawns, time); });
+		}
+
+		redis.eval<long long>("local keys = redis.call('KEYS', ARGV[1]) for _, key in ipairs(keys) do redis.call('UNLINK', key) end return #keys",
+							  {}, { "relaybench:*" });
+	}
+	catch (const sw::redis::Error& e)
+	{
+		fprintf(stderr, "redis error: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
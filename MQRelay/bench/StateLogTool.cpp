@@ -0,0 +1,321 @@
+//Reads what StateRecorder writes, and times the encoding on made up frames. Needs nothing but a compiler
+//
+//relay_state_log index <segment or directory>...           the segments, their frames and where the key frames are
+//relay_state_log stream <segment or directory> [from] [to]  each frame as a line of JSON, times in ms since the epoch
+//relay_state_log bench [frames] [spawns]                   bytes per frame and encode and decode times
+#include "StateLog.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+//A segment mapped read only, empty if it couldn't be
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::filesystem::path& path)
+	{
+#ifdef _WIN32
+		_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size) || !size.QuadPart)
+		{
+			return;
+		}
+		_mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (_mapping)
+		{
+			_data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+			_size = _data ? static_cast<size_t>(size.QuadPart) : 0;
+		}
+#else
+		_file = open(path.c_str(), O_RDONLY);
+		struct stat status = {};
+		if (_file < 0 || fstat(_file, &status) != 0 || !status.st_size)
+		{
+			return;
+		}
+		void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, _file, 0);
+		if (data != MAP_FAILED)
+		{
+			_data = static_cast<const uint8_t*>(data);
+			_size = static_cast<size_t>(status.st_size);
+		}
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (_data)
+		{
+			UnmapViewOfFile(_data);
+		}
+		if (_mapping)
+		{
+			CloseHandle(_mapping);
+		}
+		if (_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(_file);
+		}
+#else
+		if (_data)
+		{
+			munmap(const_cast<uint8_t*>(_data), _size);
+		}
+		if (_file >= 0)
+		{
+			close(_file);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	[[nodiscard]] const uint8_t* Data() const { return _data; }
+	[[nodiscard]] size_t Size() const { return _size; }
+
+private:
+#ifdef _WIN32
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = nullptr;
+#else
+	int _file = -1;
+#endif
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+};
+
+//The segments named by argv[first] up to argv[last], or the end of argv. A directory stands for every segment in it.
+//Sorted by start time
+std::vector<std::filesystem::path> Segments(int argc, char** argv, int first, int last)
+{
+	std::vector<std::filesystem::path> segments;
+	for (int i = first; i < std::min(last, argc); ++i)
+	{
+		const std::filesystem::path path(argv[i]);
+		if (!std::filesystem::is_directory(path))
+		{
+			segments.push_back(path);
+			continue;
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(path))
+		{
+			if (entry.path().extension() == ".rlog")
+			{
+				segments.push_back(entry.path());
+			}
+		}
+	}
+	//Named for the time they start at, the numbers all have the same number of digits for a good while yet
+	std::sort(segments.begin(), segments.end(), [](const auto& a, const auto& b) { return a.filename() < b.filename(); });
+	return segments;
+}
+
+int Index(const std::vector<std::filesystem::path>& segments)
+{
+	for (const auto& path : segments)
+	{
+		const MappedFile file(path);
+		StateLog::Decoder decoder(file.Data(), file.Size());
+		if (!decoder.Valid())
+		{
+			printf("%s: not a segment this version can read\n", path.string().c_str());
+			continue;
+		}
+		StateLog::Decoder::FrameInfo info;
+		size_t frames = 0;
+		long long last = decoder.StartTime();
+		std::vector<StateLog::Decoder::FrameInfo> keyFrames;
+		while (decoder.NextInfo(info))
+		{
+			++frames;
+			last = info.Time;
+			if (info.KeyFrame)
+			{
+				keyFrames.push_back(info);
+			}
+		}
+		printf("%s: %zu bytes, %zu frames from %lld to %lld, %.1f bytes a frame\n", path.string().c_str(), file.Size(), frames,
+			   decoder.StartTime(), last, frames ? static_cast<double>(file.Size() - StateLog::HeaderSize) / static_cast<double>(frames) : 0.0);
+		for (const auto& keyFrame : keyFrames)
+		{
+			printf("  key frame %lld at %zu\n", keyFrame.Time, keyFrame.Offset);
+		}
+	}
+	return 0;
+}
+
+void Print(const StateLog::Frame& frame)
+{
+	const auto& c = frame.Character;
+	printf("{\"Time\":%lld,\"Character\":{\"CurrentHP\":%lld,\"CurrentMana\":%d,\"CurrentEndurance\":%d,\"CastingSpellId\":%d,"
+		   "\"CastingTargetId\":%u,\"TargetId\":%u,\"PctAggro\":%d,\"AutoAttacking\":%s,\"AutoFiring\":%s,\"X\":%.2f,\"Y\":%.2f,\"Z\":%.2f,\"Heading\":%.1f},\"XTargets\":[",
+		   frame.Time, static_cast<long long>(c.CurrentHP), c.CurrentMana, c.CurrentEndurance, c.CastingSpellId, c.CastingTargetId, c.TargetId,
+		   c.PctAggro, c.AutoAttacking ? "true" : "false", c.AutoFiring ? "true" : "false", c.X, c.Y, c.Z, c.Heading);
+	for (size_t i = 0; i < frame.XTargets.size(); ++i)
+	{
+		const auto& x = frame.XTargets[i];
+		printf("%s{\"SpawnId\":%u,\"AggroPct\":%d,\"PctHP\":%lld}", i ? "," : "", x.SpawnId, x.AggroPct, static_cast<long long>(x.PctHP));
+	}
+	printf("],\"Spawns\":[");
+	for (size_t i = 0; i < frame.Spawns.size(); ++i)
+	{
+		const auto& s = frame.Spawns[i];
+		printf("%s{\"SpawnId\":%u,\"MasterId\":%u,\"OwnerId\":%u,\"PetId\":%u,\"Class\":%d,\"Type\":%d,\"Level\":%d,\"X\":%.2f,\"Y\":%.2f,\"Z\":%.2f,"
+			   "\"Heading\":%.1f,\"Speed\":%.2f,\"Stunned\":%s,\"Targetable\":%s}",
+			   i ? "," : "", s.SpawnId, s.MasterId, s.OwnerId, s.PetId, s.Class, s.Type, s.Level, s.X, s.Y, s.Z, s.Heading, s.Speed,
+			   s.Stunned ? "true" : "false", s.Targetable ? "true" : "false");
+	}
+	printf("]}\n");
+}
+
+int Stream(const std::vector<std::filesystem::path>& segments, long long from, long long to)
+{
+	StateLog::Frame frame;
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		const MappedFile file(segments[i]);
+		StateLog::Decoder decoder(file.Data(), file.Size());
+		if (!decoder.Valid() || decoder.StartTime() > to)
+		{
+			continue;
+		}
+		//Nothing in this segment is as late as from if the next one starts before it
+		if (i + 1 < segments.size())
+		{
+			const MappedFile next(segments[i + 1]);
+			const StateLog::Decoder nextDecoder(next.Data(), next.Size());
+			if (nextDecoder.Valid() && nextDecoder.StartTime() <= from)
+			{
+				continue;
+			}
+		}
+		decoder.Seek(from);
+		while (decoder.Next(frame) && frame.Time <= to)
+		{
+			if (frame.Time >= from)
+			{
+				Print(frame);
+			}
+		}
+	}
+	return 0;
+}
+
+//A pull's worth of spawns milling about near us, most of them standing still
+void MakeFrame(StateLog::Frame& frame, long long time, size_t spawns, size_t step)
+{
+	frame.Time = time;
+	frame.Character.CurrentHP = 50000 - static_cast<int64_t>(step % 200) * 10;
+	frame.Character.CurrentMana = 30000;
+	frame.Character.TargetId = 1000;
+	frame.Character.X = 100.0f + static_cast<float>(step % 50) * 0.3f;
+	frame.Character.Y = -250.0f;
+	frame.Character.Heading = 90.0f;
+	frame.XTargets.clear();
+	for (unsigned i = 0; i < 5; ++i)
+	{
+		frame.XTargets.push_back({ 1000 + i, 100 - static_cast<int>(i) * 10, 100 - static_cast<int64_t>(step % 100) });
+	}
+	frame.Spawns.clear();
+	for (size_t i = 0; i < spawns; ++i)
+	{
+		auto& spawn = frame.Spawns.emplace_back();
+		spawn.SpawnId = 1000 + static_cast<unsigned>(i) * 3;
+		spawn.Class = 1 + static_cast<int>(i % 16);
+		spawn.Type = 1;
+		spawn.Level = 60 + static_cast<int>(i % 5);
+		spawn.Targetable = true;
+		const float angle = static_cast<float>(i) * 2.39996f;
+		const bool moving = i % 4 == 0;
+		spawn.X = std::cos(angle) * 150.0f + (moving ? static_cast<float>(step) * 0.5f : 0.0f);
+		spawn.Y = std::sin(angle) * 150.0f;
+		spawn.Z = 3.1f;
+		spawn.Heading = static_cast<float>((i * 37) % 360);
+		spawn.Speed = moving ? 0.5f : 0.0f;
+	}
+}
+
+int Bench(size_t frames, size_t spawns)
+{
+	std::vector<StateLog::Frame> source(frames);
+	for (size_t i = 0; i < frames; ++i)
+	{
+		MakeFrame(source[i], 1700000000000LL + static_cast<long long>(i) * 100, spawns, i);
+	}
+	std::vector<uint8_t> log;
+	StateLog::Encoder encoder;
+	auto start = std::chrono::steady_clock::now();
+	encoder.BeginSegment(source[0].Time, log);
+	for (size_t i = 0; i < frames; ++i)
+	{
+		encoder.Encode(source[i], i % 100 == 0, log);
+	}
+	const std::chrono::duration<double, std::micro> encode = std::chrono::steady_clock::now() - start;
+
+	StateLog::Decoder decoder(log.data(), log.size());
+	StateLog::Frame frame;
+	size_t decoded = 0;
+	size_t mismatches = 0;
+	start = std::chrono::steady_clock::now();
+	while (decoder.Next(frame))
+	{
+		const auto& expected = source[decoded++];
+		mismatches += frame.Time != expected.Time || frame.Spawns.size() != expected.Spawns.size() || frame.Character.CurrentHP != expected.Character.CurrentHP;
+		for (size_t i = 0; i < std::min(frame.Spawns.size(), expected.Spawns.size()); ++i)
+		{
+			mismatches += frame.Spawns[i].SpawnId != expected.Spawns[i].SpawnId || std::fabs(frame.Spawns[i].X - expected.Spawns[i].X) > 0.006f;
+		}
+	}
+	const std::chrono::duration<double, std::micro> decode = std::chrono::steady_clock::now() - start;
+
+	const double raw = static_cast<double>(sizeof(StateLog::CharacterRecord) + 5 * sizeof(StateLog::XTargetRecord) + spawns * sizeof(StateLog::SpawnRecord));
+	const double perFrame = static_cast<double>(log.size() - StateLog::HeaderSize) / static_cast<double>(frames);
+	printf("%zu frames of %zu spawns, a key frame every 100\n", frames, spawns);
+	printf("  %.0f bytes a frame, %.0f as structs, %.1fx smaller\n", perFrame, raw, raw / perFrame);
+	printf("  Encode %8.2fus a frame\n", encode.count() / static_cast<double>(frames));
+	printf("  Decode %8.2fus a frame\n", decode.count() / static_cast<double>(frames));
+	printf("  %zu of %zu frames read back, %zu values different\n", decoded, frames, mismatches);
+	return decoded == frames && mismatches == 0 ? 0 : 1;
+}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string command = argc > 1 ? argv[1] : "";
+	if (command == "index" && argc > 2)
+	{
+		return Index(Segments(argc, argv, 2, argc));
+	}
+	if (command == "stream" && argc > 2)
+	{
+		const long long from = argc > 3 ? std::stoll(argv[3]) : LLONG_MIN;
+		const long long to = argc > 4 ? std::stoll(argv[4]) : LLONG_MAX;
+		return Stream(Segments(argc, argv, 2, 3), from, to);
+	}
+	if (command == "bench")
+	{
+		return Bench(std::max<size_t>(1, argc > 2 ? std::stoul(argv[2]) : 3000), argc > 3 ? std::stoul(argv[3]) : 60);
+	}
+	fprintf(stderr, "relay_state_log index <segment or directory>... | stream <segment or directory> [from] [to] | bench [frames] [spawns]\n");
+	return 2;
+}
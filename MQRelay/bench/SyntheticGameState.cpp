@@ -0,0 +1,191 @@
+#include "SyntheticGameState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+SyntheticGameState::SyntheticGameState(const SyntheticOptions& options)
+	: _options(options), _spawns(options.Spawns)
+{
+	_memberNames.emplace_back(CharacterName());
+	for (size_t i = 1; i < options.GroupMembers; ++i)
+	{
+		_memberNames.push_back("Member" + std::to_string(i));
+	}
+	for (size_t i = 0; i < _spawns.size(); ++i)
+	{
+		auto& spawn = _spawns[i];
+		spawn.Name = "a_synthetic_mob" + std::to_string(i);
+		auto& state = spawn.State;
+		state.SpawnId = FirstSpawnId + static_cast<unsigned>(i);
+		state.Class = static_cast<int>(i % 16 + 1);
+		state.Type = 1;
+		state.Level = static_cast<int>(i % 120 + 1);
+		state.Name = spawn.Name;
+		//Spread around us, close enough that every spawn is near
+		const float radius = std::sqrt(static_cast<float>(50 + i % 400));
+		const float angle = static_cast<float>(i) * 2.39996f;
+		state.X = radius * std::cos(angle);
+		state.Y = radius * std::sin(angle);
+		state.Z = 12;
+		state.Heading = 180;
+		state.Targetable = true;
+		//A few mercenaries, owned by the spawn before them
+		if (i % 50 == 1)
+		{
+			state.OwnerName = _spawns[i - 1].Name;
+		}
+		if (i % 4 == 0)
+		{
+			for (size_t b = 0; b < options.BuffsPerDebuffedSpawn; ++b)
+			{
+				spawn.Buffs.push_back({ static_cast<int>(b), 100, static_cast<int>(2000 + b), "Synthetic", 60000 });
+			}
+		}
+	}
+}
+
+void SyntheticGameState::Step()
+{
+	_step++;
+	for (size_t i = _step % 4; i < _spawns.size(); i += 4)
+	{
+		auto& state = _spawns[i].State;
+		//Back and forth so nothing wanders off
+		state.X += _step % 8 < 4 ? 1.5f : -1.5f;
+		state.Heading = static_cast<float>((_step * 7 + i) % 360);
+		state.Speed = 0.7f;
+	}
+}
+
+void SyntheticGameState::SetZone(std::string zone)
+{
+	_options.Zone = std::move(zone);
+	for (auto& spawn : _spawns)
+	{
+		spawn.State.SpawnId += static_cast<unsigned>(_spawns.size());
+	}
+}
+
+void SyntheticGameState::ReadCharacterStats(CharacterStats& stats)
+{
+	stats.SpawnId = 1;
+	stats.MaxHP = 125000;
+	stats.MaxMana = 90000;
+	stats.MaxEndurance = 40000;
+	stats.Level = 125;
+	stats.PctExp = 42.5f;
+	stats.PctAAExp = 12.25f;
+	stats.Class = 2;
+}
+
+void SyntheticGameState::ReadCharacterState(CharacterState& state)
+{
+	state.CurrentHP = 100000 + _step % 1000;
+	state.CurrentMana = 80000;
+	state.CurrentEndurance = 40000;
+	state.CombatState = "COMBAT";
+	state.AutoAttacking = true;
+	state.Heading = static_cast<float>(_step % 360);
+	state.TargetId = _spawns.empty() ? 0 : _spawns.front().State.SpawnId;
+	state.PctAggro = 100;
+	state.X = 1;
+	state.Y = 2;
+	state.Z = 3;
+	state.TargetOfTarget = 1;
+}
+
+size_t SyntheticGameState::BuffSlotCount(BuffKind kind)
+{
+	//The same slot counts as the live client
+	return kind == BuffKind::Buff ? 42 : 30;
+}
+
+void SyntheticGameState::ReadBuffSignature(BuffKind kind, size_t slot, BuffSignature& signature)
+{
+	BuffState buff;
+	ReadBuff(kind, slot, buff);
+	signature.SpellId = buff.SpellId;
+	signature.Fingerprint = 0;
+	signature.Remaining = buff.Duration;
+}
+
+void SyntheticGameState::ReadBuff(BuffKind kind, size_t slot, BuffState& buff)
+{
+	buff = {};
+	if (slot < (kind == BuffKind::Buff ? _options.CharacterBuffs : _options.CharacterSongs))
+	{
+		buff.SpellId = static_cast<int>(3000 + slot);
+		buff.Duration = 60000 - static_cast<int>(_step % 60000);
+	}
+}
+
+bool SyntheticGameState::ReadXTarget(size_t slot, XTargetState& xTarget)
+{
+	if (slot >= _spawns.size())
+	{
+		return false;
+	}
+	xTarget.SpawnId = _spawns[slot].State.SpawnId;
+	xTarget.AggroPct = 100;
+	xTarget.Role = "Auto Hater";
+	xTarget.LineOfSight = true;
+	xTarget.PctHP = static_cast<int64_t>(100 - _step % 100);
+	return true;
+}
+
+SpawnHandle SyntheticGameState::FirstSpawn()
+{
+	return _spawns.empty() ? 0 : 1;
+}
+
+SpawnHandle SyntheticGameState::NextSpawn(SpawnHandle spawn)
+{
+	return spawn < _spawns.size() ? spawn + 1 : 0;
+}
+
+void SyntheticGameState::ReadSpawn(SpawnHandle spawn, SpawnState& state)
+{
+	state = Get(spawn).State;
+}
+
+void SyntheticGameState::ReadSpawnPosition(SpawnHandle spawn, SpawnPosition& position)
+{
+	const auto& state = Get(spawn).State;
+	position.X = state.X;
+	position.Y = state.Y;
+	position.Hostile = state.MasterId == 0;
+}
+
+size_t SyntheticGameState::ReadGroupPositions(GroupMemberPosition* members, size_t count)
+{
+	//A full group standing in a line with us at the end
+	const size_t written = std::min(count, _memberNames.size());
+	for (size_t i = 0; i < written; ++i)
+	{
+		members[i] = { _memberNames[i], static_cast<float>(i) * 10, 0 };
+	}
+	return written;
+}
+
+void SyntheticGameState::ReadMeleeRanges(SpawnHandle, float& maxRange, float& maxRangeTo)
+{
+	maxRange = 14;
+	maxRangeTo = 16;
+}
+
+size_t SyntheticGameState::SpawnBuffCount(SpawnHandle spawn)
+{
+	return Get(spawn).Buffs.size();
+}
+
+bool SyntheticGameState::ReadSpawnBuff(SpawnHandle spawn, size_t index, SpawnBuffState& buff)
+{
+	buff = Get(spawn).Buffs[index];
+	return true;
+}
+
+void SyntheticGameState::ReportError(const char* message)
+{
+	fprintf(stderr, "%s\n", message);
+}
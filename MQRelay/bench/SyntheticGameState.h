@@ -0,0 +1,76 @@
+#pragma once
+#include "GameState.h"
+#include <string>
+#include <vector>
+
+struct SyntheticOptions
+{
+	size_t Spawns = 600;
+	//Every fourth spawn is debuffed, which is roughly what a raid pull looks like
+	size_t BuffsPerDebuffedSpawn = 3;
+	size_t XTargets = 5;
+	//Filled buff and song slots on our own character
+	size_t CharacterBuffs = 20;
+	size_t CharacterSongs = 5;
+	//Including us
+	size_t GroupMembers = 6;
+	//What the keys are built from. Characters given the same zone see the same spawns
+	std::string Server = "relaybench";
+	std::string Zone = "synthetic";
+	std::string Character = "Benchmark";
+	std::string Leader = "Ungrouped";
+};
+
+//A zone that exists only in memory, for running Relay without a client
+//A quarter of the spawns move each Step, so every update has some changed fields to send
+class SyntheticGameState final : public GameStateProvider
+{
+public:
+	explicit SyntheticGameState(const SyntheticOptions& options);
+	void Step();
+	//Moves us to another zone, whose spawns have ids none of the last zone's had
+	void SetZone(std::string zone);
+
+	std::string_view ServerName() override { return _options.Server; }
+	std::string_view ZoneName() override { return _options.Zone; }
+	std::string_view CharacterName() override { return _options.Character; }
+	std::string_view GroupLeaderName() override { return _options.Leader; }
+
+	void ReadCharacterStats(CharacterStats& stats) override;
+	void ReadCharacterState(CharacterState& state) override;
+	size_t BuffSlotCount(BuffKind kind) override;
+	void ReadBuffSignature(BuffKind kind, size_t slot, BuffSignature& signature) override;
+	void ReadBuff(BuffKind kind, size_t slot, BuffState& buff) override;
+	size_t XTargetSlotCount() override { return _options.XTargets; }
+	bool ReadXTarget(size_t slot, XTargetState& xTarget) override;
+	bool ReadGroupRoles(GroupRoles&) override { return false; }
+
+	SpawnHandle FirstSpawn() override;
+	SpawnHandle NextSpawn(SpawnHandle spawn) override;
+	void ReadSpawn(SpawnHandle spawn, SpawnState& state) override;
+	unsigned ReadSpawnId(SpawnHandle spawn) override { return Get(spawn).State.SpawnId; }
+	void ReadSpawnPosition(SpawnHandle spawn, SpawnPosition& position) override;
+	std::string_view ReadSpawnName(SpawnHandle spawn) override { return Get(spawn).Name; }
+	size_t ReadGroupPositions(GroupMemberPosition* members, size_t count) override;
+	uint64_t ReadMeleeRangeSignature(SpawnHandle) override { return 1; }
+	void ReadMeleeRanges(SpawnHandle spawn, float& maxRange, float& maxRangeTo) override;
+	size_t SpawnBuffCount(SpawnHandle spawn) override;
+	bool ReadSpawnBuff(SpawnHandle spawn, size_t index, SpawnBuffState& buff) override;
+
+	void ReportError(const char* message) override;
+
+private:
+	static constexpr unsigned FirstSpawnId = 1000;
+	struct Spawn
+	{
+		SpawnState State;
+		std::string Name;
+		std::vector<SpawnBuffState> Buffs;
+	};
+	//Handles are the index plus one so 0 stays free for no spawn
+	const Spawn& Get(SpawnHandle spawn) const { return _spawns[spawn - 1]; }
+	SyntheticOptions _options;
+	std::vector<Spawn> _spawns;
+	std::vector<std::string> _memberNames;
+	unsigned _step = 0;
+};
@@ -0,0 +1,134 @@
+//Two clients in one zone, then each of them leaving it, to check RelayOptions::ZoneCleanup only removes what it should.
+//While the second client is still there the first only takes its own XTarget keys with it, the spawn keys, snapshot
+//and grid they share stay. Once the second leaves too the zone is emptied.
+//Run against a local redis-server, everything it writes is under relayzonecheck and removed when it finishes
+//
+//relay_zone_check [connection string], exits with 1 if any check fails
+#include "Relay.h"
+#include "SyntheticGameState.h"
+#include <sw/redis++/redis++.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace
+{
+constexpr const char* Zone = "zonecheck";
+
+struct Client
+{
+	Client(const std::string& connection, const SyntheticOptions& synthetic, const RelayTimings& timings, const RelayOptions& options)
+		: State(synthetic), Relay(connection, State, timings, options)
+	{
+	}
+	SyntheticGameState State;
+	::Relay Relay;
+};
+
+long long CountKeys(sw::redis::Redis& redis, const std::string& pattern)
+{
+	return redis.eval<long long>("return #redis.call('KEYS', ARGV[1])", {}, { pattern });
+}
+
+//Updates every client for a while, then gives the workers time to send what they were given and the election time to answer
+template <typename... Clients>
+void Run(int updates, Clients&... clients)
+{
+	for (int i = 0; i < updates; ++i)
+	{
+		((clients.State.Step(), clients.Relay.Update()), ...);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
+
+void Leave(Client& client, const char* zone)
+{
+	client.Relay.OnBeginZone();
+	client.State.SetZone(zone);
+	client.Relay.OnZoned();
+}
+
+bool Check(bool passed, const char* what, long long value)
+{
+	printf("  %-6s %s (%lld)\n", passed ? "ok" : "FAILED", what, value);
+	return passed;
+}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string connection = argc > 1 ? argv[1] : "tcp://127.0.0.1:6379";
+	SyntheticOptions synthetic;
+	synthetic.Server = "relayzonecheck";
+	synthetic.Zone = Zone;
+	synthetic.Spawns = 200;
+
+	RelayTimings timings;
+	timings.CharacterStatsUpdateFrequency = 0;
+	timings.CharacterStateUpdateFrequency = 0;
+	timings.SpawnEngagedUpdateFrequency = 0;
+	timings.SpawnNearUpdateFrequency = 0;
+	timings.SpawnMovingUpdateFrequency = 0;
+	timings.SpawnsUpdateFrequency = 0;
+	timings.ZoneSnapshotUpdateFrequency = 0;
+	timings.SpawnSweepBudget = 0;
+	timings.XTargetUpdateFrequency = 0;
+	timings.PublisherLeaseRenewFrequency = 100;
+	timings.ZonePresenceFrequency = 100;
+	RelayOptions options;
+	options.ZoneSnapshot = true;
+	options.SpatialIndex = true;
+
+	const std::string zoneKeys = synthetic.Server + ":" + Zone + ":";
+	bool passed = true;
+	try
+	{
+		sw::redis::Redis redis(connection);
+		{
+			synthetic.Character = "ZoneCheckA";
+			Client first(connection, synthetic, timings, options);
+			synthetic.Character = "ZoneCheckB";
+			Client second(connection, synthetic, timings, options);
+
+			printf("Both clients in %s\n", Zone);
+			Run(50, first, second);
+			const auto spawnKeys = CountKeys(redis, zoneKeys + "spawns:*");
+			passed &= Check(spawnKeys >= static_cast<long long>(synthetic.Spawns), "spawn keys published", spawnKeys);
+			passed &= Check(CountKeys(redis, zoneKeys + "snapshot") == 1, "snapshot published", 1);
+			passed &= Check(CountKeys(redis, zoneKeys + "grid") == 1, "grid published", 1);
+			//The first zone's spawn ids are 1000 to 1199, the next zone's start after them
+			const std::string firstXTargets = synthetic.Server + ":*:characters:ZoneCheckA:XTargets:10??";
+			const auto xTargets = CountKeys(redis, firstXTargets);
+			passed &= Check(xTargets > 0, "first client's XTargets published", xTargets);
+
+			printf("First client leaves\n");
+			Leave(first, "zonecheckelsewhere");
+			//Only the first client updates, so nothing the second writes can put back what was removed
+			Run(5, first);
+			const auto keptSpawnKeys = CountKeys(redis, zoneKeys + "spawns:*");
+			passed &= Check(keptSpawnKeys == spawnKeys, "spawn keys kept for the second client", keptSpawnKeys);
+			passed &= Check(CountKeys(redis, zoneKeys + "snapshot") == 1, "snapshot kept", 1);
+			passed &= Check(CountKeys(redis, zoneKeys + "grid") == 1, "grid kept", 1);
+			const auto keptXTargets = CountKeys(redis, firstXTargets);
+			passed &= Check(keptXTargets == 0, "first client's XTargets removed", keptXTargets);
+
+			printf("Second client leaves\n");
+			//Long enough to take over the lease and publish the whole zone, as the publisher would
+			Run(50, first, second);
+			Leave(second, "zonecheckelsewhere");
+			Run(5, second);
+			const auto remaining = CountKeys(redis, zoneKeys + "*");
+			passed &= Check(remaining == 0, "zone emptied", remaining);
+		}
+		redis.eval<long long>("local keys = redis.call('KEYS', ARGV[1]) for _, key in ipairs(keys) do redis.call('UNLINK', key) end return #keys",
+							  {}, { synthetic.Server + ":*" });
+	}
+	catch (const sw::redis::Error& e)
+	{
+		fprintf(stderr, "redis error: %s\n", e.what());
+		return 1;
+	}
+	return passed ? 0 : 1;
+}
@@ -171,10 +171,13 @@ function StateClass:update()
     self.Sneaking = me.Sneaking()
     self.Standing = me.Standing()
     self.XTHaterCount = me.XTHaterCount() or 0
-    self.EngageTargetId = me.GroupAssistTarget.ID() -- TODO: Pull this from Redis
+    --The coordinator's pick when MQRelay is mirroring the blackboard, reading it doesn't leave the client
+    --Relay() is the string "TRUE" or "FALSE", both truthy, Live is the boolean
+    local relay = mq.TLO.Relay
+    self.EngageTargetId = (relay.Live() and tonumber(relay.Blackboard('EngageTargetId')())) or me.GroupAssistTarget.ID()
     self.EngageTargetDistance = 0
     self.EngageTargetMaxRangeTo = 999999999
-    self.EngageTargetHealth = me.GroupAssistTarget.PctHPs()
+    self.EngageTargetHealth = 0
     self.EngagePosition = ClassPositions[me.Class.ShortName()]()
     self.Mounted = me.Mount.ID() ~= nil
     self.TargetId = mq.TLO.Target.ID()
@@ -182,6 +185,8 @@ function StateClass:update()
         local theEngageSpawn = mq.TLO.Spawn(self.EngageTargetId)
         self.EngageTargetDistance = theEngageSpawn.Distance()
         self.EngageTargetMaxRangeTo = theEngageSpawn.MaxRangeTo()
+        --The same spawn as EngageTargetId, which isn't always the group's assist target
+        self.EngageTargetHealth = theEngageSpawn.PctHPs()
     else
         self.EngageTargetMaxRangeTo = 999999999
     end
@@ -0,0 +1,170 @@
+--SpatialIndex.lua
+--Radius and nearest-N spawn queries against the spatial index MQRelay keeps under <server>:<zone>:grid
+--The index is described in MQRelay/SpatialIndex.h and the script is RelayScripts::SpawnsNear, keep the two in step
+--Relays only keep the index with SpatialIndex=on under [Options] in MQRelay.ini, without it every query comes back empty
+
+local SpatialIndex = {
+    CellOffset = 1048576,
+    RowStride = 2097152,
+    --RelayOptions::SpatialCellSize and RelayOptions::SpatialMoveThreshold, the queries have to agree with the relays
+    CellSize = 100,
+    MoveThreshold = 10
+}
+
+---@class NearbySpawn
+---@field SpawnId integer
+---@field Distance number @On X and Y only
+
+SpatialIndex.Script = [==[
+-- KEYS[1]: Spatial index of the format "<server>:<zone>:grid", see SpatialIndex.h
+-- ARGV[1]: Spawn key prefix of the format "<server>:<zone>:spawns:"
+-- ARGV[2], ARGV[3]: X and Y to search around
+-- ARGV[4]: Radius
+-- ARGV[5]: How many of the nearest spawns to return, 0 for every spawn in the radius
+-- ARGV[6]: Cell size the index is built with, RelayOptions::SpatialCellSize
+-- ARGV[7]: How far a spawn moves before it's indexed again, RelayOptions::SpatialMoveThreshold
+-- Returns spawn id and distance pairs, nearest first. Distances only go by X and Y
+-- Read only. It reads each candidate's spawn hash, ARGV[1] .. id, without it being in KEYS. That works on a
+-- single redis, a cluster would need the grid and the hashes to share a hash tag
+
+local grid = KEYS[1]
+local prefix = ARGV[1]
+local x = tonumber(ARGV[2])
+local y = tonumber(ARGV[3])
+local radius = tonumber(ARGV[4])
+local count = tonumber(ARGV[5])
+local cellSize = tonumber(ARGV[6])
+local slack = tonumber(ARGV[7])
+local offset = 1048576
+local stride = 2097152
+local cx = math.floor(x / cellSize)
+local cy = math.floor(y / cellSize)
+-- A spawn can be indexed up to slack away from where its hash says it is
+local maxRing = math.ceil((radius + slack) / cellSize)
+
+local found = {}
+local searched = -1
+
+local function searchCells(row, from, to)
+    if from > to then
+        return
+    end
+    local base = (row + offset) * stride + offset
+    local ids = redis.call('ZRANGEBYSCORE', grid, base + from, base + to)
+    for _, id in ipairs(ids) do
+        local position = redis.call('HMGET', prefix .. id, 'X', 'Y')
+        local px = tonumber(position[1])
+        local py = tonumber(position[2])
+        -- A spawn whose hash expired is skipped, the publisher takes it out of the index with GridPrune
+        if px and py then
+            local dx = px - x
+            local dy = py - y
+            local distance = math.sqrt(dx * dx + dy * dy)
+            if distance <= radius then
+                found[#found + 1] = { id, distance }
+            end
+        end
+    end
+end
+
+-- Searches every cell up to ring cells away that hasn't been searched yet
+local function search(ring)
+    ring = math.min(ring, maxRing)
+    if ring <= searched then
+        return
+    end
+    for row = cy - ring, cy + ring do
+        if searched >= 0 and row >= cy - searched and row <= cy + searched then
+            searchCells(row, cx - ring, cx - searched - 1)
+            searchCells(row, cx + searched + 1, cx + ring)
+        else
+            searchCells(row, cx - ring, cx + ring)
+        end
+    end
+    searched = ring
+end
+
+local function byDistance(a, b)
+    return a[2] < b[2]
+end
+
+if count <= 0 then
+    search(maxRing)
+else
+    -- Grow the search until it has enough spawns, then widen it to anything that could be nearer than the furthest of them
+    local ring = 0
+    search(ring)
+    while #found < count and searched < maxRing do
+        ring = math.max(1, ring * 2)
+        search(ring)
+    end
+    if #found >= count then
+        table.sort(found, byDistance)
+        search(math.ceil((found[count][2] + slack) / cellSize))
+    end
+end
+
+table.sort(found, byDistance)
+local result = {}
+local limit = #found
+if count > 0 and count < limit then
+    limit = count
+end
+for i = 1, limit do
+    result[#result + 1] = found[i][1]
+    result[#result + 1] = string.format('%.2f', found[i][2])
+end
+return result
+]==]
+
+--- The score a position is indexed under
+---@param x number
+---@param y number
+---@param cellSize number|nil Defaults to SpatialIndex.CellSize
+---@return number
+function SpatialIndex.Score(x, y, cellSize)
+    cellSize = cellSize or SpatialIndex.CellSize
+    local column = math.floor(x / cellSize) + SpatialIndex.CellOffset
+    local row = math.floor(y / cellSize) + SpatialIndex.CellOffset
+    return row * SpatialIndex.RowStride + column
+end
+
+--- Keys and arguments for running SpatialIndex.Script with EVAL or EVALSHA
+---@param server string
+---@param zone string Short zone name, as it appears in the spawn keys
+---@param x number
+---@param y number
+---@param radius number
+---@param count integer|nil How many of the nearest spawns to return, nil or 0 for every spawn in the radius
+---@return string[] keys
+---@return string[] args
+function SpatialIndex.Query(server, zone, x, y, radius, count)
+    local base = server .. ":" .. zone
+    local keys = { base .. ":grid" }
+    local args = {
+        base .. ":spawns:",
+        tostring(x),
+        tostring(y),
+        tostring(radius),
+        tostring(count or 0),
+        tostring(SpatialIndex.CellSize),
+        tostring(SpatialIndex.MoveThreshold)
+    }
+    return keys, args
+end
+
+--- Turns the script's reply into spawns, nearest first
+---@param reply string[] Spawn id and distance pairs
+---@return NearbySpawn[]
+function SpatialIndex.Decode(reply)
+    local spawns = {}
+    for i = 1, #reply - 1, 2 do
+        spawns[#spawns + 1] = {
+            SpawnId = tonumber(reply[i]),
+            Distance = tonumber(reply[i + 1])
+        }
+    end
+    return spawns
+end
+
+return SpatialIndex
@@ -0,0 +1,152 @@
+--ZoneSnapshot.lua
+--Decodes the binary zone snapshot MQRelay publishes under <server>:<zone>:snapshot
+--The layout is documented in MQRelay/ZoneSnapshot.h, everything is little endian
+--Relays only write it with ZoneSnapshot=on under [Options] in MQRelay.ini, see MQRelay/README.md
+
+local ZoneSnapshot = {
+    Magic = 0x4E535A54,
+    Version = 1,
+    HeaderSize = 24,
+    --The smallest record this version reads, later versions only append fields
+    RecordSize = 56,
+    Flags = {
+        Stunned = 1,
+        Targetable = 2
+    }
+}
+
+---@class SnapshotSpawn
+---@field SpawnId integer
+---@field MasterId integer
+---@field OwnerId integer
+---@field PetId integer
+---@field X number
+---@field Y number
+---@field Z number
+---@field Heading number
+---@field Distance number @Squared distance from whoever published the snapshot
+---@field Speed number
+---@field MaxRange number
+---@field MaxRangeTo number
+---@field Name string
+---@field Level integer
+---@field Class integer
+---@field Type integer
+---@field Mark integer
+---@field Stunned boolean
+---@field Targetable boolean
+
+---@class Snapshot
+---@field Time number @Milliseconds since the epoch when the snapshot was taken
+---@field Spawns SnapshotSpawn[]
+---@field ById table<integer, SnapshotSpawn>
+
+local function readU8(data, pos)
+    return data:byte(pos)
+end
+
+local function readU16(data, pos)
+    local b1, b2 = data:byte(pos, pos + 1)
+    return b1 + b2 * 256
+end
+
+local function readU32(data, pos)
+    local b1, b2, b3, b4 = data:byte(pos, pos + 3)
+    return b1 + b2 * 256 + b3 * 65536 + b4 * 16777216
+end
+
+local function readF32(data, pos)
+    local b1, b2, b3, b4 = data:byte(pos, pos + 3)
+    local sign = b4 >= 128 and -1 or 1
+    local exponent = (b4 % 128) * 2 + math.floor(b3 / 128)
+    local mantissa = ((b3 % 128) * 256 + b2) * 256 + b1
+    if exponent == 0 then
+        return sign * math.ldexp(mantissa, -149)
+    end
+    if exponent == 255 then
+        return mantissa == 0 and sign * math.huge or 0 / 0
+    end
+    return sign * math.ldexp(1 + mantissa / 8388608, exponent - 127)
+end
+
+local function hasFlag(flags, flag)
+    return math.floor(flags / flag) % 2 == 1
+end
+
+--- Decodes a snapshot read from redis
+---@param data string The raw value of the snapshot key
+---@return Snapshot|nil snapshot nil if data isn't a snapshot this version understands
+---@return string|nil error Why it couldn't be decoded
+function ZoneSnapshot.Decode(data)
+    if data == nil or data == false then
+        return nil, "no snapshot, is ZoneSnapshot on for the zone's relays?"
+    end
+    if type(data) ~= "string" or #data < ZoneSnapshot.HeaderSize then
+        return nil, "too short"
+    end
+    if readU32(data, 1) ~= ZoneSnapshot.Magic then
+        return nil, "not a zone snapshot"
+    end
+    if readU16(data, 5) ~= ZoneSnapshot.Version then
+        return nil, "unsupported version " .. readU16(data, 5)
+    end
+    local recordSize = readU16(data, 7)
+    local recordCount = readU32(data, 9)
+    local nameCount = readU32(data, 13)
+    if recordSize < ZoneSnapshot.RecordSize then
+        return nil, "record size " .. recordSize .. " is too small"
+    end
+    if #data < ZoneSnapshot.HeaderSize + recordSize * recordCount then
+        return nil, "truncated"
+    end
+
+    --The name table comes after the records, records refer to it by index
+    local names = {}
+    local pos = ZoneSnapshot.HeaderSize + recordSize * recordCount + 1
+    for i = 0, nameCount - 1 do
+        local length = readU8(data, pos)
+        if not length or pos + length > #data then
+            return nil, "truncated"
+        end
+        names[i] = data:sub(pos + 1, pos + length)
+        pos = pos + 1 + length
+    end
+
+    ---@type Snapshot
+    local snapshot = {
+        Time = readU32(data, 17) + readU32(data, 21) * 4294967296,
+        Spawns = {},
+        ById = {}
+    }
+    pos = ZoneSnapshot.HeaderSize + 1
+    for i = 1, recordCount do
+        local flags = readU8(data, pos + 54)
+        local spawn = {
+            SpawnId = readU32(data, pos),
+            MasterId = readU32(data, pos + 4),
+            OwnerId = readU32(data, pos + 8),
+            PetId = readU32(data, pos + 12),
+            X = readF32(data, pos + 16),
+            Y = readF32(data, pos + 20),
+            Z = readF32(data, pos + 24),
+            Heading = readF32(data, pos + 28),
+            Distance = readF32(data, pos + 32),
+            Speed = readF32(data, pos + 36),
+            MaxRange = readF32(data, pos + 40),
+            MaxRangeTo = readF32(data, pos + 44),
+            Name = names[readU16(data, pos + 48)],
+            Level = readU8(data, pos + 50),
+            Class = readU8(data, pos + 51),
+            Type = readU8(data, pos + 52),
+            Mark = readU8(data, pos + 53),
+            Stunned = hasFlag(flags, ZoneSnapshot.Flags.Stunned),
+            Targetable = hasFlag(flags, ZoneSnapshot.Flags.Targetable)
+        }
+        snapshot.Spawns[i] = spawn
+        snapshot.ById[spawn.SpawnId] = spawn
+        pos = pos + recordSize
+    end
+    return snapshot
+end
+
+return ZoneSnapshot